@@ -4,6 +4,8 @@
 // STL headers
 #include <iostream>
 #include <cstring>
+#include <sstream>
+#include <stdexcept>
 
 // ----------------------------------------------------------------------------
 // Project headers
@@ -0,0 +1,128 @@
+#include <euclideanClustering.h>
+#include <unionFind.h>
+#include <voxelGrid.h>
+
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+EuclideanClustering::EuclideanClustering(const float & _tolerance,
+                                         const size_t & _minClusterSize,
+                                         const size_t & _maxClusterSize)
+  : tolerance(_tolerance), minClusterSize(_minClusterSize),
+    maxClusterSize(_maxClusterSize) {
+  if(tolerance <= 0.0f) throwRuntimeError("Tolerance cannot be <= 0.0f");
+  if(minClusterSize > maxClusterSize)
+    throwRuntimeError("Minimum cluster size exceeds the maximum");
+}
+
+/// Writes the cluster of every point to its flags
+size_t EuclideanClustering::cluster(Points& points) const {
+  if(points.empty()) throwRuntimeError("Input point cloud cant be empty");
+  std::vector<int> labels;
+  const size_t numClusters(label(XYZView(points), labels));
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for(size_t i = 0; i < points.size(); i++) points[i].flags = labels[i];
+  return numClusters;
+}
+
+/// Clusters as ranges of point ids, without copying points
+size_t EuclideanClustering::extract(const XYZView& points,
+                                    std::vector<size_t>& offsets,
+                                    std::vector<uint32_t>& ids) const {
+  if(points.size() == 0) throwRuntimeError("Input point cloud cant be empty");
+  std::vector<int> labels;
+  const size_t numClusters(label(points, labels));
+
+  offsets.assign(numClusters + 1, 0);
+  for(const int l : labels)
+    if(l >= 0) offsets[l + 1]++;
+  for(size_t c = 0; c < numClusters; c++) offsets[c + 1] += offsets[c];
+
+  ids.resize(offsets[numClusters]);
+  std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+  for(size_t i = 0; i < labels.size(); i++)
+    if(labels[i] >= 0) ids[next[labels[i]]++] = static_cast<uint32_t>(i);
+  return numClusters;
+}
+
+/// cluster of every point or -1, returns the number of clusters
+size_t EuclideanClustering::label(const XYZView& points,
+                                  std::vector<int>& labels) const {
+  const size_t n(points.size());
+  VoxelGrid voxels(tolerance);
+  voxels.build(points);
+  const float sqrTolerance(tolerance * tolerance);
+
+  UnionFind sets(n);
+  const size_t numVoxels(voxels.numVoxels());
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for(size_t v = 0; v < numVoxels; v++) {
+    // v itself and the adjacent voxels after it, so every pair of voxels
+    // is visited once
+    uint64_t vx, vy, vz;
+    voxels.voxelCoordinates(v, vx, vy, vz);
+    size_t neighbors[27];
+    int numNeighbors = 0;
+    for(int dz = -1; dz <= 1; dz++) {
+      for(int dy = -1; dy <= 1; dy++) {
+        for(int dx = -1; dx <= 1; dx++) {
+          if((vx == 0 && dx < 0) || (vy == 0 && dy < 0) || (vz == 0 && dz < 0))
+            continue;
+          const size_t other(voxels.findVoxel(vx + dx, vy + dy, vz + dz));
+          if(other != numVoxels && other >= v)
+            neighbors[numNeighbors++] = other;
+        }
+      }
+    }
+
+    const uint32_t* ids(voxels.voxelBegin(v));
+    const size_t size(voxels.voxelSize(v));
+    for(size_t k = 0; k < size; k++) {
+      const uint32_t id(ids[k]);
+      const float px(points.getX(id)), py(points.getY(id)),
+                  pz(points.getZ(id));
+      for(int j = 0; j < numNeighbors; j++) {
+        const uint32_t* others(voxels.voxelBegin(neighbors[j]));
+        const size_t numOthers(voxels.voxelSize(neighbors[j]));
+        for(size_t o = neighbors[j] == v ? k + 1 : 0; o < numOthers; o++) {
+          const uint32_t other(others[o]);
+          const float dx(points.getX(other) - px);
+          const float dy(points.getY(other) - py);
+          const float dz(points.getZ(other) - pz);
+          if(dx * dx + dy * dy + dz * dz <= sqrTolerance)
+            sets.unite(id, other);
+        }
+      }
+    }
+  }
+
+  // roots are the first point of their cluster, number the clusters in
+  // root order
+  std::vector<uint32_t> roots(n);
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for(size_t i = 0; i < n; i++) roots[i] = sets.find(i);
+
+  std::vector<size_t> sizes(n, 0);
+  for(size_t i = 0; i < n; i++) sizes[roots[i]]++;
+  std::vector<int> clusterOf(n, -1);
+  int numClusters = 0;
+  for(size_t i = 0; i < n; i++)
+    if(sizes[i] > 0 && sizes[i] >= minClusterSize && sizes[i] <= maxClusterSize)
+      clusterOf[i] = numClusters++;
+
+  labels.resize(n);
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for(size_t i = 0; i < n; i++) labels[i] = clusterOf[roots[i]];
+
+  LOG << "Found " << numClusters << " clusters";
+  return numClusters;
+}
@@ -0,0 +1,56 @@
+#ifndef _EUCLIDEAN_CLUSTERING_H_
+#define _EUCLIDEAN_CLUSTERING_H_
+
+// STL
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// 3DL headers
+#include <common.h>
+#include <pointCloud.h>
+
+/** \class EuclideanClustering
+  * \brief Connected components of the points closer than a tolerance.
+  *
+  * Bins the points into a VoxelGrid whose leaf size is the tolerance, so
+  * every edge of the neighborhood graph joins points of the same or of
+  * adjacent voxels. Voxels generate their edges in parallel, looking only
+  * at their own points and the adjacent voxels with a larger index, so
+  * every pair of voxels is visited once, and merge the points of every
+  * edge in a lock-free UnionFind. Clusters are numbered in the order of their first point, so the result
+  * doesnt depend on the thread count.
+  */
+class EuclideanClustering {
+  protected:
+    const float               tolerance;
+    const size_t              minClusterSize;
+    const size_t              maxClusterSize;
+
+  public:
+    EuclideanClustering(const float & _tolerance,
+                        const size_t & _minClusterSize = 1,
+                        const size_t & _maxClusterSize =
+                            std::numeric_limits<size_t>::max());
+
+    /** Writes the cluster of every point to its flags
+     *
+     *  Points of clusters outside [minClusterSize, maxClusterSize] get the
+     *  flag -1. Returns the number of clusters.
+     */
+    size_t cluster(Points& points) const;
+
+    /** Clusters as ranges of point ids, without copying points
+     *
+     *  The ids of cluster c are ids[offsets[c]..offsets[c + 1]), ascending,
+     *  gathered by a counting sort of the labels. Points of rejected
+     *  clusters are left out. Returns the number of clusters.
+     */
+    size_t extract(const XYZView& points, std::vector<size_t>& offsets,
+                   std::vector<uint32_t>& ids) const;
+
+    /// cluster of every point or -1, returns the number of clusters
+    size_t label(const XYZView& points, std::vector<int>& labels) const;
+}; // class EuclideanClustering
+
+#endif // _EUCLIDEAN_CLUSTERING_H_
@@ -0,0 +1,20 @@
+#include <common.h>
+#include <plyTiler.h>
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+      LOG << "Need to more arguments" << std::endl
+          << "\tUsage: ./plyTilerEx pointCloud.ply outputFolder "
+          << "[tileSize] [maxOpenFiles]";
+      return EXIT_FAILURE;
+    }
+
+    const float tileSize(argc > 3 ? std::atof(argv[3]) : 100.0f);
+    const size_t maxOpenFiles(argc > 4 ? std::atol(argv[4]) : 64);
+
+    PlyTiler tiler(tileSize, argv[2], maxOpenFiles);
+    const size_t numTiles(tiler.tile(argv[1]));
+    LOG << "Number of tiles = " << numTiles;
+
+    return EXIT_SUCCESS;
+}
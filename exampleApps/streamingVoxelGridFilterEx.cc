@@ -0,0 +1,21 @@
+#include <common.h>
+#include <streamingVoxelGridFilter.h>
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+      LOG << "Need to more arguments" << std::endl
+          << "\tUsage: ./streamingVoxelGridFilterEx pointCloud.ply out.ply "
+          << "[leafSize] [memoryBudgetMB]";
+      return EXIT_FAILURE;
+    }
+
+    const float leafSize(argc > 3 ? std::atof(argv[3]) : 0.01f);
+    const size_t budgetMB(argc > 4 ? std::atol(argv[4]) : 1024);
+
+    StreamingVoxelGridFilter svgf(leafSize, VoxelReduction::kMean,
+                                  budgetMB << 20);
+    const size_t numPoints(svgf.filter(argv[1], argv[2]));
+    LOG << "Number of points = " << numPoints;
+
+    return EXIT_SUCCESS;
+}
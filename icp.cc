@@ -0,0 +1,226 @@
+#include <icp.h>
+#include <linearAlgebra.h>
+
+#include <cmath>
+#include <limits>
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/// source points accumulated into one set of normal equations
+const size_t kBlockSize = 4096;
+
+/// normal equations of a block of correspondences
+struct NormalEquations {
+  double              a[6][6] = {};
+  double              b[6] = {};
+  size_t              count = 0;
+  double              sqrError = 0.0;
+
+  void add(const NormalEquations& other) {
+    for(int i = 0; i < 6; i++) {
+      for(int j = 0; j <= i; j++) a[i][j] += other.a[i][j];
+      b[i] += other.b[i];
+    }
+    count += other.count;
+    sqrError += other.sqrError;
+  }
+};
+
+} // namespace
+
+/// this transform applied after other
+RigidTransform RigidTransform::compose(const RigidTransform& other) const {
+  RigidTransform result;
+  for(int i = 0; i < 3; i++) {
+    for(int j = 0; j < 3; j++) {
+      result.rotation[i][j] = 0.0;
+      for(int k = 0; k < 3; k++)
+        result.rotation[i][j] += rotation[i][k] * other.rotation[k][j];
+    }
+    result.translation[i] = translation[i];
+    for(int k = 0; k < 3; k++)
+      result.translation[i] += rotation[i][k] * other.translation[k];
+  }
+  return result;
+}
+
+/// transform of the rotation vector omega (axis times angle) and t
+RigidTransform RigidTransform::fromTwist(const double omega[3],
+                                         const double t[3]) {
+  RigidTransform result;
+  const double angle(std::sqrt(linalg::dot3(omega, omega)));
+  // Rodrigues, R = I + sin a K + (1 - cos a) K^2 with K the unit axis
+  // cross product matrix
+  const double s(angle > 0.0 ? std::sin(angle) / angle : 1.0);
+  const double c(angle > 0.0 ? (1.0 - std::cos(angle)) / (angle * angle)
+                             : 0.5);
+  const double k[3][3] = {{0.0, -omega[2], omega[1]},
+                          {omega[2], 0.0, -omega[0]},
+                          {-omega[1], omega[0], 0.0}};
+  for(int i = 0; i < 3; i++) {
+    for(int j = 0; j < 3; j++) {
+      double k2 = 0.0;
+      for(int m = 0; m < 3; m++) k2 += k[i][m] * k[m][j];
+      result.rotation[i][j] = (i == j) + s * k[i][j] + c * k2;
+    }
+    result.translation[i] = t[i];
+  }
+  return result;
+}
+
+IterativeClosestPoint::IterativeClosestPoint(
+    const float & _maxCorrespondenceDistance, const size_t & _maxIterations,
+    const double & _convergenceThreshold)
+  : maxCorrespondenceDistance(_maxCorrespondenceDistance),
+    maxIterations(_maxIterations),
+    convergenceThreshold(_convergenceThreshold),
+    minNormalCos(std::cos(45.0f * float(M_PI / 180.0))),
+    target(nullptr), numIterations(0), numCorrespondences(0), rms(0.0),
+    isConverged(false) {
+  if(maxCorrespondenceDistance <= 0.0f)
+    throwRuntimeError("Correspondence distance cannot be <= 0.0f");
+}
+
+/// Rejects pairs whose normals differ by more than maxAngle degrees
+void IterativeClosestPoint::setMaxNormalAngle(const float maxAngle) {
+  minNormalCos = std::cos(maxAngle * float(M_PI / 180.0));
+}
+
+/// Indexes target, it has to outlive the following align calls
+void IterativeClosestPoint::setTarget(const Points& _target) {
+  if(_target.empty()) throwRuntimeError("Target point cloud cant be empty");
+  target = &_target;
+  targetTree.build(XYZView(_target));
+}
+
+/// Transform moving source onto the target, starting from guess
+RigidTransform IterativeClosestPoint::align(const Points& source,
+                                            const RigidTransform& guess) {
+  if(!target) throwRuntimeError("No target set");
+  if(source.empty()) throwRuntimeError("Source point cloud cant be empty");
+
+  // linearize around the source centroid, large coordinates would make
+  // the rotation part of the normal equations ill conditioned
+  double center[3] = {0.0, 0.0, 0.0};
+  for(const Point& p : source) {
+    const Point q(guess.apply(p));
+    center[0] += q.x; center[1] += q.y; center[2] += q.z;
+  }
+  for(int a = 0; a < 3; a++) center[a] /= source.size();
+
+  RigidTransform transform(guess);
+  numIterations = 0;
+  numCorrespondences = 0;
+  rms = 0.0;
+  isConverged = false;
+
+  const float maxSqrDistance(maxCorrespondenceDistance
+                             * maxCorrespondenceDistance);
+  double maxSqrResidual(std::numeric_limits<double>::max());
+  const size_t n(source.size());
+  const size_t numBlocks((n + kBlockSize - 1) / kBlockSize);
+  std::vector<NormalEquations> blocks(numBlocks);
+
+  while(numIterations < maxIterations) {
+#ifdef USE_OpenMP
+    #pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for(size_t blockId = 0; blockId < numBlocks; blockId++) {
+      NormalEquations& block = blocks[blockId];
+      block = NormalEquations();
+      const size_t end(std::min(n, (blockId + 1) * kBlockSize));
+      for(size_t i = blockId * kBlockSize; i < end; i++) {
+        const Point s(transform.apply(source[i]));
+        uint32_t id;
+        float sqrDistance;
+        if(!targetTree.knn(s.x, s.y, s.z, 1, &id, &sqrDistance)
+            || sqrDistance > maxSqrDistance)
+          continue;
+
+        const Point& d = (*target)[id];
+        const double normal[3] = {d.nx, d.ny, d.nz};
+        const double normalLength(linalg::dot3(normal, normal));
+        if(!(normalLength > 0.5)) continue;
+        const double sourceNormal[3] = {s.nx, s.ny, s.nz};
+        if(linalg::dot3(sourceNormal, sourceNormal) > 0.5
+            && std::abs(linalg::dot3(sourceNormal, normal)) < minNormalCos)
+          continue;
+
+        const double p[3] = {s.x - center[0], s.y - center[1],
+                             s.z - center[2]};
+        const double residual((double(s.x) - d.x) * normal[0]
+                              + (double(s.y) - d.y) * normal[1]
+                              + (double(s.z) - d.z) * normal[2]);
+        if(residual * residual > maxSqrResidual) continue;
+
+        // d residual / d (omega, t) = (p x n, n)
+        double jacobian[6];
+        linalg::cross3(p, normal, jacobian);
+        jacobian[3] = normal[0];
+        jacobian[4] = normal[1];
+        jacobian[5] = normal[2];
+        for(int r = 0; r < 6; r++) {
+          for(int c = 0; c <= r; c++) block.a[r][c] += jacobian[r] * jacobian[c];
+          block.b[r] -= jacobian[r] * residual;
+        }
+        block.count++;
+        block.sqrError += residual * residual;
+      }
+    }
+
+    NormalEquations total;
+    for(const NormalEquations& block : blocks) total.add(block);
+    numCorrespondences = total.count;
+    if(total.count < 6) {
+      LOG << "ICP found only " << total.count << " correspondences";
+      break;
+    }
+    rms = std::sqrt(total.sqrError / total.count);
+
+    double update[6];
+    if(!linalg::choleskySolve<6>(total.a, total.b, update)) {
+      LOG << "ICP normal equations are degenerate";
+      break;
+    }
+    numIterations++;
+
+    // the update rotates around the centroid
+    const RigidTransform step(RigidTransform::fromTwist(update, update + 3));
+    RigidTransform delta(step);
+    for(int i = 0; i < 3; i++) {
+      delta.translation[i] += center[i];
+      for(int k = 0; k < 3; k++)
+        delta.translation[i] -= step.rotation[i][k] * center[k];
+    }
+    transform = delta.compose(transform);
+    for(int i = 0; i < 3; i++) {
+      center[i] += update[3 + i];
+    }
+
+    const double rotation(std::sqrt(linalg::dot3(update, update)));
+    const double translation(std::sqrt(linalg::dot3(update + 3, update + 3)));
+    if(rotation < convergenceThreshold
+        && translation < convergenceThreshold * maxCorrespondenceDistance) {
+      isConverged = true;
+      break;
+    }
+    maxSqrResidual = 9.0 * rms * rms;
+  }
+  DEBUG << "ICP " << numIterations << " iterations, " << numCorrespondences
+        << " correspondences, rms " << rms;
+  return transform;
+}
+
+/// Applies transform to every point of input
+void transformPoints(const Points& input, const RigidTransform& transform,
+                     Points& result) {
+  result.resize(input.size());
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for(size_t i = 0; i < input.size(); i++)
+    result[i] = transform.apply(input[i]);
+}
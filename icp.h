@@ -0,0 +1,106 @@
+#ifndef _ICP_H_
+#define _ICP_H_
+
+// STL
+#include <cstdint>
+#include <vector>
+
+// 3DL headers
+#include <common.h>
+#include <kdTree.h>
+
+/*! \brief Rotation followed by a translation, p' = R p + t
+ */
+struct RigidTransform {
+  double      rotation[3][3];
+  double      translation[3];
+
+  RigidTransform() {
+    for(int i = 0; i < 3; i++) {
+      for(int j = 0; j < 3; j++) rotation[i][j] = (i == j);
+      translation[i] = 0.0;
+    }
+  }
+
+  /// applies the transform to the coordinates and rotates the normal
+  Point apply(const Point& p) const {
+    Point q(p);
+    q.x = rotation[0][0] * p.x + rotation[0][1] * p.y + rotation[0][2] * p.z
+          + translation[0];
+    q.y = rotation[1][0] * p.x + rotation[1][1] * p.y + rotation[1][2] * p.z
+          + translation[1];
+    q.z = rotation[2][0] * p.x + rotation[2][1] * p.y + rotation[2][2] * p.z
+          + translation[2];
+    q.nx = rotation[0][0] * p.nx + rotation[0][1] * p.ny + rotation[0][2] * p.nz;
+    q.ny = rotation[1][0] * p.nx + rotation[1][1] * p.ny + rotation[1][2] * p.nz;
+    q.nz = rotation[2][0] * p.nx + rotation[2][1] * p.ny + rotation[2][2] * p.nz;
+    return q;
+  }
+
+  /// this transform applied after other
+  RigidTransform compose(const RigidTransform& other) const;
+
+  /// transform of the rotation vector omega (axis times angle) and t
+  static RigidTransform fromTwist(const double omega[3], const double t[3]);
+};
+
+/** \class IterativeClosestPoint
+  * \brief Point to plane ICP registration of a source cloud onto a target.
+  *
+  * The KdTree of the target is built once by setTarget. Every iteration
+  * finds the closest target point of every transformed source point in
+  * parallel, rejects pairs that are too far apart, whose normals disagree
+  * or whose residual exceeds three times the rms of the previous
+  * iteration, and solves the linearized point to plane problem
+  * sum ((R s + t - d) . n)^2 as a 6x6 normal equation. The normal equations
+  * are accumulated per fixed block of source points and summed in block
+  * order, so the result doesnt depend on the thread count. The target
+  * needs normals.
+  */
+class IterativeClosestPoint {
+  protected:
+    const float               maxCorrespondenceDistance;
+    const size_t              maxIterations;
+    /// stop once the update rotates less than this (radians) and moves
+    /// less than this times maxCorrespondenceDistance
+    const double              convergenceThreshold;
+    /// cosine of the largest angle between paired normals
+    float                     minNormalCos;
+
+    const Points*             target;
+    KdTree                    targetTree;
+
+    // statistics of the last align
+    size_t                    numIterations;
+    size_t                    numCorrespondences;
+    double                    rms;
+    bool                      isConverged;
+
+  public:
+    IterativeClosestPoint(const float & _maxCorrespondenceDistance,
+                          const size_t & _maxIterations = 30,
+                          const double & _convergenceThreshold = 1e-6);
+
+    /// Rejects pairs whose normals differ by more than maxAngle degrees,
+    /// only used when the source has normals, 45 by default
+    void setMaxNormalAngle(const float maxAngle);
+
+    /// Indexes target, it has to outlive the following align calls
+    void setTarget(const Points& _target);
+
+    /// Transform moving source onto the target, starting from guess
+    RigidTransform align(const Points& source,
+                         const RigidTransform& guess = RigidTransform());
+
+    inline size_t iterations() const { return numIterations; }
+    inline size_t correspondences() const { return numCorrespondences; }
+    /// rms point to plane distance of the last iteration's correspondences
+    inline double rmsError() const { return rms; }
+    inline bool converged() const { return isConverged; }
+}; // class IterativeClosestPoint
+
+/// Applies transform to every point of input
+void transformPoints(const Points& input, const RigidTransform& transform,
+                     Points& result);
+
+#endif // _ICP_H_
@@ -0,0 +1,290 @@
+#include <kdTree.h>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/// ranges at least this large are split as a parallel task
+const size_t kTaskPoints = size_t(1) << 15;
+
+/// queries collected into one buffer by radiusBatch
+const size_t kQueryBlock = 1024;
+
+/// moves value down from position i of the max heap on distances
+inline void siftDown(float* distances, uint32_t* ids, const size_t count,
+                     size_t i, const float distance, const uint32_t id) {
+  for(;;) {
+    size_t child(2 * i + 1);
+    if(child >= count) break;
+    if(child + 1 < count && distances[child + 1] > distances[child]) child++;
+    if(distances[child] <= distance) break;
+    distances[i] = distances[child];
+    ids[i] = ids[child];
+    i = child;
+  }
+  distances[i] = distance;
+  ids[i] = id;
+}
+
+inline void pushHeap(float* distances, uint32_t* ids, size_t& count,
+                     const float distance, const uint32_t id) {
+  size_t i(count++);
+  while(i > 0) {
+    const size_t parent((i - 1) / 2);
+    if(distances[parent] >= distance) break;
+    distances[i] = distances[parent];
+    ids[i] = ids[parent];
+    i = parent;
+  }
+  distances[i] = distance;
+  ids[i] = id;
+}
+
+} // namespace
+
+KdTree::KdTree(const size_t & _leafSize)
+  : leafSize(_leafSize), levels(0) {
+  if(leafSize == 0) throwRuntimeError("Leaf size cannot be 0");
+}
+
+/// Builds the tree over points, replacing any previous build
+void KdTree::build(const XYZView& points) {
+  const size_t n(points.size());
+  if(n > std::numeric_limits<uint32_t>::max())
+    throwRuntimeError("Too many points for the kd tree");
+
+  // halve until the leaves are small enough
+  levels = 0;
+  while(((n + (size_t(1) << levels) - 1) >> levels) > leafSize) levels++;
+  splits.assign((size_t(1) << levels) - 1, 0.0f);
+  axes.assign(splits.size(), 0);
+
+  ids.resize(n);
+  std::iota(ids.begin(), ids.end(), 0);
+#ifdef USE_OpenMP
+  #pragma omp parallel
+  #pragma omp single
+#endif
+  buildNode(points, ids.data(), 0, 0, 0, n);
+
+  x.resize(n);
+  y.resize(n);
+  z.resize(n);
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for(size_t i = 0; i < n; i++) {
+    x[i] = points.getX(ids[i]);
+    y[i] = points.getY(ids[i]);
+    z[i] = points.getZ(ids[i]);
+  }
+}
+
+void KdTree::buildNode(const XYZView& points, uint32_t* order,
+                       const size_t node, const int level, const size_t begin,
+                       const size_t end) {
+  if(level == levels) return;
+
+  // split the widest axis at the median
+  float lo[3], hi[3];
+  for(int a = 0; a < 3; a++) {
+    lo[a] = std::numeric_limits<float>::max();
+    hi[a] = std::numeric_limits<float>::lowest();
+  }
+  for(size_t i = begin; i < end; i++) {
+    const uint32_t id(order[i]);
+    const float c[3] = {points.getX(id), points.getY(id), points.getZ(id)};
+    for(int a = 0; a < 3; a++) {
+      lo[a] = std::min(lo[a], c[a]);
+      hi[a] = std::max(hi[a], c[a]);
+    }
+  }
+  int axis = 0;
+  for(int a = 1; a < 3; a++)
+    if(hi[a] - lo[a] > hi[axis] - lo[axis]) axis = a;
+
+  const XYZView* view = &points;
+  auto value = [view, axis](const uint32_t id) {
+    return axis == 0 ? view->getX(id)
+                     : (axis == 1 ? view->getY(id) : view->getZ(id));
+  };
+  const size_t mid(begin + (end - begin) / 2);
+  std::nth_element(order + begin, order + mid, order + end,
+                   [&value](const uint32_t a, const uint32_t b) {
+                     return value(a) < value(b);
+                   });
+  splits[node] = value(order[mid]);
+  axes[node] = static_cast<uint8_t>(axis);
+
+  if(end - begin >= kTaskPoints) {
+#ifdef USE_OpenMP
+    #pragma omp task
+#endif
+    buildNode(*view, order, 2 * node + 1, level + 1, begin, mid);
+#ifdef USE_OpenMP
+    #pragma omp task
+#endif
+    buildNode(*view, order, 2 * node + 2, level + 1, mid, end);
+#ifdef USE_OpenMP
+    #pragma omp taskwait
+#endif
+  } else {
+    buildNode(points, order, 2 * node + 1, level + 1, begin, mid);
+    buildNode(points, order, 2 * node + 2, level + 1, mid, end);
+  }
+}
+
+/// k nearest neighbors of (qx, qy, qz)
+size_t KdTree::knn(const float qx, const float qy, const float qz,
+                   const size_t k, uint32_t* resultIds,
+                   float* sqrDistances) const {
+  if(k == 0 || empty()) return 0;
+  const float q[3] = {qx, qy, qz};
+  size_t found = 0;
+  knnNode(q, k, 0, 0, 0, size(), found, resultIds, sqrDistances);
+
+  // heap sort, nearest first
+  for(size_t m = found; m > 1; m--) {
+    const float distance(sqrDistances[m - 1]);
+    const uint32_t id(resultIds[m - 1]);
+    sqrDistances[m - 1] = sqrDistances[0];
+    resultIds[m - 1] = resultIds[0];
+    siftDown(sqrDistances, resultIds, m - 1, 0, distance, id);
+  }
+  return found;
+}
+
+void KdTree::knnNode(const float q[3], const size_t k, const size_t node,
+                     const int level, const size_t begin, const size_t end,
+                     size_t& found, uint32_t* resultIds,
+                     float* sqrDistances) const {
+  if(level == levels) {
+    for(size_t i = begin; i < end; i++) {
+      const float dx(x[i] - q[0]), dy(y[i] - q[1]), dz(z[i] - q[2]);
+      const float d(dx * dx + dy * dy + dz * dz);
+      if(found < k)
+        pushHeap(sqrDistances, resultIds, found, d, ids[i]);
+      else if(d < sqrDistances[0])
+        siftDown(sqrDistances, resultIds, found, 0, d, ids[i]);
+    }
+    return;
+  }
+  const float diff(q[axes[node]] - splits[node]);
+  const size_t mid(begin + (end - begin) / 2);
+  // near side first, the far side only if the split plane is close enough
+  if(diff < 0.0f) {
+    knnNode(q, k, 2 * node + 1, level + 1, begin, mid, found, resultIds,
+            sqrDistances);
+    if(found < k || diff * diff < sqrDistances[0])
+      knnNode(q, k, 2 * node + 2, level + 1, mid, end, found, resultIds,
+              sqrDistances);
+  } else {
+    knnNode(q, k, 2 * node + 2, level + 1, mid, end, found, resultIds,
+            sqrDistances);
+    if(found < k || diff * diff < sqrDistances[0])
+      knnNode(q, k, 2 * node + 1, level + 1, begin, mid, found, resultIds,
+              sqrDistances);
+  }
+}
+
+/// Appends the indices and squared distances of all points within radius
+/// of (qx, qy, qz), in tree order
+void KdTree::radius(const float qx, const float qy, const float qz,
+                    const float radius, std::vector<uint32_t>& resultIds,
+                    std::vector<float>& sqrDistances) const {
+  if(empty()) return;
+  const float q[3] = {qx, qy, qz};
+  radiusNode(q, radius * radius, 0, 0, 0, size(), resultIds, sqrDistances);
+}
+
+void KdTree::radiusNode(const float q[3], const float sqrRadius,
+                        const size_t node, const int level,
+                        const size_t begin, const size_t end,
+                        std::vector<uint32_t>& resultIds,
+                        std::vector<float>& sqrDistances) const {
+  if(level == levels) {
+    for(size_t i = begin; i < end; i++) {
+      const float dx(x[i] - q[0]), dy(y[i] - q[1]), dz(z[i] - q[2]);
+      const float d(dx * dx + dy * dy + dz * dz);
+      if(d <= sqrRadius) {
+        resultIds.push_back(ids[i]);
+        sqrDistances.push_back(d);
+      }
+    }
+    return;
+  }
+  const float diff(q[axes[node]] - splits[node]);
+  const size_t mid(begin + (end - begin) / 2);
+  if(diff <= 0.0f || diff * diff <= sqrRadius)
+    radiusNode(q, sqrRadius, 2 * node + 1, level + 1, begin, mid, resultIds,
+               sqrDistances);
+  if(diff >= 0.0f || diff * diff <= sqrRadius)
+    radiusNode(q, sqrRadius, 2 * node + 2, level + 1, mid, end, resultIds,
+               sqrDistances);
+}
+
+/// k nearest neighbors of every query, in parallel
+size_t KdTree::knnBatch(const XYZView& queries, const size_t k,
+                        std::vector<uint32_t>& resultIds,
+                        std::vector<float>& sqrDistances) const {
+  const size_t rowSize(std::min(k, size()));
+  const size_t numQueries(queries.size());
+  resultIds.resize(numQueries * rowSize);
+  sqrDistances.resize(numQueries * rowSize);
+  if(rowSize == 0) return 0;
+
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(dynamic, 256)
+#endif
+  for(size_t i = 0; i < numQueries; i++)
+    knn(queries.getX(i), queries.getY(i), queries.getZ(i), rowSize,
+        &resultIds[i * rowSize], &sqrDistances[i * rowSize]);
+  return rowSize;
+}
+
+/// Points within radius of every query, in parallel
+void KdTree::radiusBatch(const XYZView& queries, const float radius,
+                         std::vector<size_t>& offsets,
+                         std::vector<uint32_t>& resultIds,
+                         std::vector<float>& sqrDistances) const {
+  const size_t numQueries(queries.size());
+  const size_t numBlocks((numQueries + kQueryBlock - 1) / kQueryBlock);
+  std::vector<std::vector<uint32_t> > blockIds(numBlocks);
+  std::vector<std::vector<float> > blockDistances(numBlocks);
+  offsets.assign(numQueries + 1, 0);
+
+  // every block collects its own results, the counts go to offsets
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for(size_t b = 0; b < numBlocks; b++) {
+    const size_t end(std::min(numQueries, (b + 1) * kQueryBlock));
+    for(size_t i = b * kQueryBlock; i < end; i++) {
+      const size_t before(blockIds[b].size());
+      this->radius(queries.getX(i), queries.getY(i), queries.getZ(i), radius,
+                   blockIds[b], blockDistances[b]);
+      offsets[i + 1] = blockIds[b].size() - before;
+    }
+  }
+  for(size_t i = 0; i < numQueries; i++) offsets[i + 1] += offsets[i];
+
+  resultIds.resize(offsets[numQueries]);
+  sqrDistances.resize(offsets[numQueries]);
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for(size_t b = 0; b < numBlocks; b++) {
+    const size_t start(offsets[b * kQueryBlock]);
+    std::copy(blockIds[b].begin(), blockIds[b].end(),
+              resultIds.begin() + start);
+    std::copy(blockDistances[b].begin(), blockDistances[b].end(),
+              sqrDistances.begin() + start);
+    std::vector<uint32_t>().swap(blockIds[b]);
+    std::vector<float>().swap(blockDistances[b]);
+  }
+}
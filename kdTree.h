@@ -0,0 +1,92 @@
+#ifndef _KD_TREE_H_
+#define _KD_TREE_H_
+
+// STL
+#include <cstdint>
+#include <vector>
+
+// 3DL headers
+#include <common.h>
+#include <pointCloud.h>
+
+/** \class KdTree
+  * \brief Balanced k-d tree for nearest neighbor and radius queries.
+  *
+  * Every node splits its points at the median of their widest axis, so the
+  * tree is implicit: node k has the children 2k + 1 and 2k + 2, covers a
+  * range of points that follows from halving the ranges of its ancestors,
+  * and only its split value and axis are stored. The coordinates are
+  * copied in tree order into aligned arrays, so a leaf is a short
+  * contiguous scan. The top levels are built as parallel tasks and the
+  * batched queries run over all cores.
+  */
+class KdTree {
+  private:
+    const size_t              leafSize;
+    int                       levels; ///< levels of split nodes
+    AlignedVector<float>      x, y, z; ///< coordinates in tree order
+    std::vector<uint32_t>     ids; ///< original index of every position
+    std::vector<float>        splits; ///< split value of every split node
+    std::vector<uint8_t>      axes; ///< split axis of every split node
+
+  public:
+    KdTree(const size_t & _leafSize = 16);
+
+    /// Builds the tree over points, replacing any previous build
+    void build(const XYZView& points);
+
+    inline size_t size() const { return ids.size(); }
+    inline bool empty() const { return ids.empty(); }
+
+    /** k nearest neighbors of (qx, qy, qz)
+     *
+     *  Writes min(k, size()) point indices and squared distances, nearest
+     *  first, and returns their number.
+     */
+    size_t knn(const float qx, const float qy, const float qz, const size_t k,
+               uint32_t* resultIds, float* sqrDistances) const;
+
+    /// Appends the indices and squared distances of all points within
+    /// radius of (qx, qy, qz), in tree order
+    void radius(const float qx, const float qy, const float qz,
+                const float radius, std::vector<uint32_t>& resultIds,
+                std::vector<float>& sqrDistances) const;
+
+    /** k nearest neighbors of every query, in parallel
+     *
+     *  Row i of resultIds and sqrDistances holds the neighbors of query i,
+     *  rows have min(k, size()) entries, which is returned.
+     */
+    size_t knnBatch(const XYZView& queries, const size_t k,
+                    std::vector<uint32_t>& resultIds,
+                    std::vector<float>& sqrDistances) const;
+
+    /** Points within radius of every query, in parallel
+     *
+     *  Compressed rows: the neighbors of query i are the entries
+     *  [offsets[i], offsets[i + 1]) of resultIds and sqrDistances. Blocks
+     *  of queries collect into their own buffers, which are concatenated
+     *  in query order at the end.
+     */
+    void radiusBatch(const XYZView& queries, const float radius,
+                     std::vector<size_t>& offsets,
+                     std::vector<uint32_t>& resultIds,
+                     std::vector<float>& sqrDistances) const;
+
+  private:
+    void buildNode(const XYZView& points, uint32_t* order,
+                   const size_t node, const int level, const size_t begin,
+                   const size_t end);
+
+    void knnNode(const float q[3], const size_t k, const size_t node,
+                 const int level, const size_t begin, const size_t end,
+                 size_t& found, uint32_t* resultIds,
+                 float* sqrDistances) const;
+
+    void radiusNode(const float q[3], const float sqrRadius,
+                    const size_t node, const int level, const size_t begin,
+                    const size_t end, std::vector<uint32_t>& resultIds,
+                    std::vector<float>& sqrDistances) const;
+}; // class KdTree
+
+#endif // _KD_TREE_H_
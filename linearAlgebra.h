@@ -0,0 +1,213 @@
+#ifndef _LINEAR_ALGEBRA_H_
+#define _LINEAR_ALGEBRA_H_
+
+// STL
+#include <algorithm>
+#include <cmath>
+
+namespace linalg {
+
+inline void cross3(const double a[3], const double b[3], double out[3]) {
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+inline double dot3(const double a[3], const double b[3]) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+/// unit eigenvector of the symmetric matrix m for the simple eigenvalue
+/// eigenvalue, taken from the largest cross product of the rows of m - eI
+inline void eigenvector0(const double m[6], const double eigenvalue,
+                         double v[3]) {
+  const double r0[3] = {m[0] - eigenvalue, m[1], m[2]};
+  const double r1[3] = {m[1], m[3] - eigenvalue, m[4]};
+  const double r2[3] = {m[2], m[4], m[5] - eigenvalue};
+  double c[3][3];
+  cross3(r0, r1, c[0]);
+  cross3(r0, r2, c[1]);
+  cross3(r1, r2, c[2]);
+  int best = 0;
+  double bestNorm = dot3(c[0], c[0]);
+  for(int i = 1; i < 3; i++) {
+    const double norm(dot3(c[i], c[i]));
+    if(norm > bestNorm) {
+      bestNorm = norm;
+      best = i;
+    }
+  }
+  if(bestNorm > 0.0) {
+    const double inv(1.0 / std::sqrt(bestNorm));
+    for(int k = 0; k < 3; k++) v[k] = c[best][k] * inv;
+  } else {
+    // m - eI vanishes, every vector is an eigenvector
+    v[0] = 1.0; v[1] = 0.0; v[2] = 0.0;
+  }
+}
+
+/// unit eigenvector for eigenvalue orthogonal to the eigenvector v0,
+/// solved in the plane orthogonal to v0 so repeated eigenvalues are fine
+inline void eigenvector1(const double m[6], const double v0[3],
+                         const double eigenvalue, double v1[3]) {
+  // orthonormal basis u, w of the complement of v0
+  double u[3];
+  if(std::abs(v0[0]) > std::abs(v0[1])) {
+    const double inv(1.0 / std::sqrt(v0[0] * v0[0] + v0[2] * v0[2]));
+    u[0] = -v0[2] * inv; u[1] = 0.0; u[2] = v0[0] * inv;
+  } else {
+    const double inv(1.0 / std::sqrt(v0[1] * v0[1] + v0[2] * v0[2]));
+    u[0] = 0.0; u[1] = v0[2] * inv; u[2] = -v0[1] * inv;
+  }
+  double w[3];
+  cross3(v0, u, w);
+
+  const double mu[3] = {m[0] * u[0] + m[1] * u[1] + m[2] * u[2],
+                        m[1] * u[0] + m[3] * u[1] + m[4] * u[2],
+                        m[2] * u[0] + m[4] * u[1] + m[5] * u[2]};
+  const double mw[3] = {m[0] * w[0] + m[1] * w[1] + m[2] * w[2],
+                        m[1] * w[0] + m[3] * w[1] + m[4] * w[2],
+                        m[2] * w[0] + m[4] * w[1] + m[5] * w[2]};
+  // 2x2 system | a b ; b c | restricted to span(u, w)
+  double a(dot3(u, mu) - eigenvalue);
+  double b(dot3(u, mw));
+  double c(dot3(w, mw) - eigenvalue);
+  const double absA(std::abs(a)), absB(std::abs(b)), absC(std::abs(c));
+
+  double s(1.0), t(0.0); // v1 = s * u + t * w
+  if(absA >= absC) {
+    if(absA >= absB && absA > 0.0) {
+      b /= a;
+      a = 1.0 / std::sqrt(1.0 + b * b);
+      b *= a;
+      s = b; t = -a;
+    } else if(absB > 0.0) {
+      a /= b;
+      b = 1.0 / std::sqrt(1.0 + a * a);
+      a *= b;
+      s = b; t = -a;
+    }
+  } else {
+    if(absC >= absB) {
+      b /= c;
+      c = 1.0 / std::sqrt(1.0 + b * b);
+      b *= c;
+      s = c; t = -b;
+    } else {
+      c /= b;
+      b = 1.0 / std::sqrt(1.0 + c * c);
+      c *= b;
+      s = c; t = -b;
+    }
+  }
+  for(int k = 0; k < 3; k++) v1[k] = s * u[k] + t * w[k];
+}
+
+/*! \brief Closed form eigen decomposition of a symmetric 3x3 matrix
+ *
+ *  The matrix is given by its upper triangle
+ *  | m[0] m[1] m[2] |
+ *  | m[1] m[3] m[4] |
+ *  | m[2] m[4] m[5] |
+ *  Eigenvalues are returned ascending and eigenvectors[i] is the unit
+ *  eigenvector of eigenvalues[i]. The eigenvectors form a right handed
+ *  orthonormal basis, also when eigenvalues are repeated. No iterations,
+ *  so the cost is the same for every matrix.
+ */
+inline void symmetricEigen3(const double matrix[6], double eigenvalues[3],
+                            double eigenvectors[3][3]) {
+  // scale to [-1, 1] to avoid overflow and keep the precision
+  double scale(0.0);
+  for(int i = 0; i < 6; i++) scale = std::max(scale, std::abs(matrix[i]));
+  if(scale == 0.0) {
+    for(int i = 0; i < 3; i++) {
+      eigenvalues[i] = 0.0;
+      for(int k = 0; k < 3; k++) eigenvectors[i][k] = (i == k);
+    }
+    return;
+  }
+  double m[6];
+  for(int i = 0; i < 6; i++) m[i] = matrix[i] / scale;
+
+  const double offDiagonal(m[1] * m[1] + m[2] * m[2] + m[4] * m[4]);
+  if(offDiagonal == 0.0) {
+    // diagonal, sort the axes by their values
+    int order[3] = {0, 1, 2};
+    const double diag[3] = {m[0], m[3], m[5]};
+    std::sort(order, order + 3,
+              [&diag](int i, int j) { return diag[i] < diag[j]; });
+    for(int i = 0; i < 3; i++) {
+      eigenvalues[i] = diag[order[i]] * scale;
+      for(int k = 0; k < 3; k++) eigenvectors[i][k] = (order[i] == k);
+    }
+    // keep the basis right handed
+    cross3(eigenvectors[0], eigenvectors[1], eigenvectors[2]);
+    return;
+  }
+
+  // trigonometric solution of the characteristic polynomial
+  const double q((m[0] + m[3] + m[5]) / 3.0);
+  const double b00(m[0] - q), b11(m[3] - q), b22(m[5] - q);
+  const double p(std::sqrt((b00 * b00 + b11 * b11 + b22 * b22
+                            + 2.0 * offDiagonal) / 6.0));
+  const double halfDet((b00 * (b11 * b22 - m[4] * m[4])
+                        - m[1] * (m[1] * b22 - m[4] * m[2])
+                        + m[2] * (m[1] * m[4] - b11 * m[2]))
+                       / (2.0 * p * p * p));
+  const double phi(std::acos(std::max(-1.0, std::min(1.0, halfDet))) / 3.0);
+  double values[3];
+  values[2] = q + 2.0 * p * std::cos(phi);
+  values[0] = q + 2.0 * p * std::cos(phi + 2.0 * M_PI / 3.0);
+  values[1] = 3.0 * q - values[0] - values[2];
+
+  // start from the eigenvalue furthest from the other two, it is simple
+  if(halfDet >= 0.0) {
+    eigenvector0(m, values[2], eigenvectors[2]);
+    eigenvector1(m, eigenvectors[2], values[1], eigenvectors[1]);
+    cross3(eigenvectors[1], eigenvectors[2], eigenvectors[0]);
+  } else {
+    eigenvector0(m, values[0], eigenvectors[0]);
+    eigenvector1(m, eigenvectors[0], values[1], eigenvectors[1]);
+    cross3(eigenvectors[0], eigenvectors[1], eigenvectors[2]);
+  }
+  for(int i = 0; i < 3; i++) eigenvalues[i] = values[i] * scale;
+}
+
+/*! \brief Solves a x = b for a symmetric positive definite N x N matrix
+ *
+ *  Cholesky decomposition, only the lower triangle of a is read. Returns
+ *  false if a isnt positive definite, x is undefined then.
+ */
+template <int N>
+inline bool choleskySolve(const double a[N][N], const double b[N],
+                          double x[N]) {
+  double l[N][N];
+  for(int i = 0; i < N; i++) {
+    for(int j = 0; j <= i; j++) {
+      double sum(a[i][j]);
+      for(int k = 0; k < j; k++) sum -= l[i][k] * l[j][k];
+      if(i == j) {
+        if(!(sum > 0.0)) return false;
+        l[i][i] = std::sqrt(sum);
+      } else {
+        l[i][j] = sum / l[j][j];
+      }
+    }
+  }
+  // forward substitution l y = b, then backward l^T x = y
+  for(int i = 0; i < N; i++) {
+    double sum(b[i]);
+    for(int k = 0; k < i; k++) sum -= l[i][k] * x[k];
+    x[i] = sum / l[i][i];
+  }
+  for(int i = N - 1; i >= 0; i--) {
+    double sum(x[i]);
+    for(int k = i + 1; k < N; k++) sum -= l[k][i] * x[k];
+    x[i] = sum / l[i][i];
+  }
+  return true;
+}
+
+} // namespace linalg
+
+#endif // _LINEAR_ALGEBRA_H_
@@ -0,0 +1,217 @@
+#include <lodPyramid.h>
+#include <morton.h>
+#include <radixSort.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/// sums of the attributes of the points in a cell
+struct CellSums {
+  double              x = 0.0, y = 0.0, z = 0.0;
+  double              nx = 0.0, ny = 0.0, nz = 0.0;
+  uint64_t            r = 0, g = 0, b = 0, a = 0;
+  uint64_t            count = 0;
+
+  void add(const Point& p) {
+    x += p.x; y += p.y; z += p.z;
+    nx += p.nx; ny += p.ny; nz += p.nz;
+    r += p.r; g += p.g; b += p.b; a += p.a;
+    count++;
+  }
+
+  void add(const CellSums& o) {
+    x += o.x; y += o.y; z += o.z;
+    nx += o.nx; ny += o.ny; nz += o.nz;
+    r += o.r; g += o.g; b += o.b; a += o.a;
+    count += o.count;
+  }
+
+  Point mean() const {
+    Point p;
+    p.x = static_cast<float>(x / count);
+    p.y = static_cast<float>(y / count);
+    p.z = static_cast<float>(z / count);
+    p.nx = static_cast<float>(nx / count);
+    p.ny = static_cast<float>(ny / count);
+    p.nz = static_cast<float>(nz / count);
+    p.r = static_cast<uint8_t>(r / count);
+    p.g = static_cast<uint8_t>(g / count);
+    p.b = static_cast<uint8_t>(b / count);
+    p.a = static_cast<uint8_t>(a / count);
+    return p;
+  }
+};
+
+/// index of the point of points[0..n) with the least summed distance to
+/// the others, each distance weighted by weights[j] or 1 if null
+size_t weightedMediod(const Point* points, const uint64_t* weights,
+                      const size_t n) {
+  size_t best = 0;
+  double bestSum = std::numeric_limits<double>::max();
+  for(size_t c = 0; c < n; c++) {
+    double sum = 0.0;
+    for(size_t j = 0; j < n && sum < bestSum; j++) {
+      const float dx(points[j].x - points[c].x);
+      const float dy(points[j].y - points[c].y);
+      const float dz(points[j].z - points[c].z);
+      const double d(std::sqrt(dx * dx + dy * dy + dz * dz));
+      sum += weights ? weights[j] * d : d;
+    }
+    if(sum < bestSum) {
+      best = c;
+      bestSum = sum;
+    }
+  }
+  return best;
+}
+
+/// starts of the runs of equal keys >> shift, with keys.size() appended
+void runStarts(const std::vector<uint64_t>& keys, const int shift,
+               std::vector<size_t>& starts) {
+  starts.clear();
+  for(size_t i = 0; i < keys.size(); i++)
+    if(i == 0 || (keys[i] >> shift) != (keys[i - 1] >> shift))
+      starts.push_back(i);
+  starts.push_back(keys.size());
+}
+
+} // namespace
+
+LodPyramid::LodPyramid(const float & _leafSize, const size_t & _maxLevels,
+                       const bool & _useMediod)
+  : leafSize(_leafSize), maxLevels(_maxLevels), useMediod(_useMediod) {
+  if(leafSize <= 0.0f) throwRuntimeError("Leaf size cannot be <= 0.0f");
+  if(maxLevels == 0) throwRuntimeError("Need at least one level");
+  if(maxLevels > size_t(kMortonAxisBits))
+    throwRuntimeError("Too many levels");
+}
+
+/// Builds the levels, stops early once a level has a single cell
+void LodPyramid::build(const Points& input) {
+  const size_t n(input.size());
+  if(n == 0) throwRuntimeError("Input point cloud cant be empty");
+  if(n > std::numeric_limits<uint32_t>::max())
+    throwRuntimeError("Too many points for the pyramid");
+  levels.clear();
+
+  float x0 = std::numeric_limits<float>::max();
+  float y0 = std::numeric_limits<float>::max();
+  float z0 = std::numeric_limits<float>::max();
+  float x1 = std::numeric_limits<float>::lowest();
+  float y1 = std::numeric_limits<float>::lowest();
+  float z1 = std::numeric_limits<float>::lowest();
+#ifdef USE_OpenMP
+  #pragma omp parallel for reduction(min:x0,y0,z0) reduction(max:x1,y1,z1)
+#endif
+  for(size_t i = 0; i < n; i++) {
+    const Point& p = input[i];
+    x0 = std::min(x0, p.x); y0 = std::min(y0, p.y); z0 = std::min(z0, p.z);
+    x1 = std::max(x1, p.x); y1 = std::max(y1, p.y); z1 = std::max(z1, p.z);
+  }
+  const float extent(std::max(x1 - x0, std::max(y1 - y0, z1 - z0)));
+  if(extent / leafSize >= float(kMortonAxisSize))
+    throwRuntimeError("Leaf size too small for the extent of the cloud");
+
+  // bin once at the finest level
+  std::vector<uint64_t> keys(n);
+  std::vector<uint32_t> ids(n);
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for(size_t i = 0; i < n; i++) {
+    const Point& p = input[i];
+    const uint64_t x(std::min<uint64_t>(kMortonAxisSize - 1,
+        static_cast<uint64_t>(std::max(0.0f, (p.x - x0) / leafSize))));
+    const uint64_t y(std::min<uint64_t>(kMortonAxisSize - 1,
+        static_cast<uint64_t>(std::max(0.0f, (p.y - y0) / leafSize))));
+    const uint64_t z(std::min<uint64_t>(kMortonAxisSize - 1,
+        static_cast<uint64_t>(std::max(0.0f, (p.z - z0) / leafSize))));
+    keys[i] = mortonEncode3(x, y, z);
+    ids[i] = static_cast<uint32_t>(i);
+  }
+  radixSortPairs(keys, ids, 3 * kMortonAxisBits);
+
+  std::vector<size_t> starts;
+  runStarts(keys, 0, starts);
+  size_t numCells(starts.size() - 1);
+  std::vector<uint64_t> cellKeys(numCells);
+  std::vector<CellSums> sums(useMediod ? 0 : numCells);
+  std::vector<uint64_t> weights(useMediod ? numCells : 0);
+  Points cells(numCells);
+#ifdef USE_OpenMP
+  #pragma omp parallel
+#endif
+  {
+    Points members;
+#ifdef USE_OpenMP
+    #pragma omp for schedule(dynamic, 256)
+#endif
+    for(size_t c = 0; c < numCells; c++) {
+      const size_t begin(starts[c]), end(starts[c + 1]);
+      cellKeys[c] = keys[begin];
+      if(useMediod) {
+        members.clear();
+        for(size_t k = begin; k < end; k++) members.push_back(input[ids[k]]);
+        cells[c] = members[weightedMediod(members.data(), nullptr,
+                                          members.size())];
+        weights[c] = end - begin;
+      } else {
+        for(size_t k = begin; k < end; k++) sums[c].add(input[ids[k]]);
+        cells[c] = sums[c].mean();
+      }
+    }
+  }
+  levels.push_back(std::move(cells));
+
+  // every coarser level from the cells of the previous one
+  while(levels.size() < maxLevels && numCells > 1) {
+    runStarts(cellKeys, 3, starts);
+    const size_t numParents(starts.size() - 1);
+    const Points& children = levels.back();
+    std::vector<uint64_t> parentKeys(numParents);
+    std::vector<CellSums> parentSums(useMediod ? 0 : numParents);
+    std::vector<uint64_t> parentWeights(useMediod ? numParents : 0);
+    Points parents(numParents);
+#ifdef USE_OpenMP
+    #pragma omp parallel for schedule(dynamic, 256)
+#endif
+    for(size_t c = 0; c < numParents; c++) {
+      const size_t begin(starts[c]), end(starts[c + 1]);
+      parentKeys[c] = cellKeys[begin] >> 3;
+      if(useMediod) {
+        parents[c] = children[begin + weightedMediod(
+            children.data() + begin, weights.data() + begin, end - begin)];
+        for(size_t k = begin; k < end; k++) parentWeights[c] += weights[k];
+      } else {
+        for(size_t k = begin; k < end; k++) parentSums[c].add(sums[k]);
+        parents[c] = parentSums[c].mean();
+      }
+    }
+    cellKeys.swap(parentKeys);
+    sums.swap(parentSums);
+    weights.swap(parentWeights);
+    numCells = numParents;
+    levels.push_back(std::move(parents));
+  }
+  LOG << "Built " << levels.size() << " levels, finest has "
+      << levels.front().size() << " points";
+}
+
+/// Writes level l to a ply file with the given vertex properties
+void LodPyramid::writeLevel(const size_t l, const std::string& filename,
+                            const bool normals, const bool colors,
+                            const bool flags, const bool binary) const {
+  if(l >= levels.size()) throwRuntimeError("No such level");
+  PlyWriter writer(filename, binary);
+  writer.addVertexElement(true, normals, colors, flags);
+  writer.setPointsCount(levels[l].size());
+  writer.writeHeader();
+  writer.writePoints(levels[l]);
+  writer.closeFile();
+}
@@ -0,0 +1,58 @@
+#ifndef _LOD_PYRAMID_H_
+#define _LOD_PYRAMID_H_
+
+// STL
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 3DL headers
+#include <common.h>
+#include <plyIO.h>
+
+/** \class LodPyramid
+  * \brief Multi-resolution voxel downsampling in a single binning pass.
+  *
+  * The points are binned once at the finest leaf size by sorting their
+  * Morton codes with the parallel radix sort. Level l has leaf size
+  * leafSize * 2^l, and since the parent of a Morton cell is its code
+  * shifted right by 3, the cells of level l + 1 are runs of consecutive
+  * cells of level l. Every coarser level is therefore derived from the
+  * previous one in time linear in its number of cells, without touching
+  * the points again.
+  *
+  * With the mean every cell keeps the sums of its points, so each level
+  * holds the exact means, the same as a VoxelGridFilter with that leaf
+  * size and the same grid origin. With the mediod the finest level holds
+  * the exact mediod of every cell and a coarser cell takes the weighted
+  * mediod of its up to 8 children's mediods, weighted by their number of
+  * points, which approximates the mediod of the whole cell.
+  */
+class LodPyramid {
+  protected:
+    const float               leafSize; ///< of the finest level
+    const size_t              maxLevels;
+    const bool                useMediod;
+    std::vector<Points>       levels; ///< finest first
+
+  public:
+    LodPyramid(const float & _leafSize, const size_t & _maxLevels,
+               const bool & _useMediod = false);
+
+    /// Builds the levels, stops early once a level has a single cell
+    void build(const Points& input);
+
+    inline size_t numLevels() const { return levels.size(); }
+    inline const Points& level(const size_t l) const { return levels[l]; }
+    /// leaf size of level l
+    inline float levelLeafSize(const size_t l) const {
+      return leafSize * static_cast<float>(uint64_t(1) << l);
+    }
+
+    /// Writes level l to a ply file with the given vertex properties
+    void writeLevel(const size_t l, const std::string& filename,
+                    const bool normals = true, const bool colors = true,
+                    const bool flags = false, const bool binary = true) const;
+}; // class LodPyramid
+
+#endif // _LOD_PYRAMID_H_
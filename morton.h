@@ -0,0 +1,52 @@
+#ifndef _MORTON_H_
+#define _MORTON_H_
+
+// STL
+#include <cstdint>
+
+/// Bits per axis of a 64 bit Morton code
+const int       kMortonAxisBits = 21;
+/// Number of distinct coordinates per axis of a 64 bit Morton code
+const uint64_t  kMortonAxisSize = uint64_t(1) << kMortonAxisBits;
+
+/// spreads the low 21 bits of v so that two zero bits follow each bit
+inline uint64_t mortonSplit3(uint64_t v) {
+  v &= kMortonAxisSize - 1;
+  v = (v | v << 32) & 0x001f00000000ffffull;
+  v = (v | v << 16) & 0x001f0000ff0000ffull;
+  v = (v | v <<  8) & 0x100f00f00f00f00full;
+  v = (v | v <<  4) & 0x10c30c30c30c30c3ull;
+  v = (v | v <<  2) & 0x1249249249249249ull;
+  return v;
+}
+
+/// inverse of mortonSplit3, gathers every third bit
+inline uint64_t mortonCompact3(uint64_t v) {
+  v &= 0x1249249249249249ull;
+  v = (v ^ (v >>  2)) & 0x10c30c30c30c30c3ull;
+  v = (v ^ (v >>  4)) & 0x100f00f00f00f00full;
+  v = (v ^ (v >>  8)) & 0x001f0000ff0000ffull;
+  v = (v ^ (v >> 16)) & 0x001f00000000ffffull;
+  v = (v ^ (v >> 32)) & 0x00000000001fffffull;
+  return v;
+}
+
+/*! \brief Interleaves the low 21 bits of x, y and z into a 63 bit code
+ *
+ *  x occupies bit 0, y bit 1 and z bit 2 of every 3 bit group, so the
+ *  parent of a code in an octree is code >> 3.
+ */
+inline uint64_t mortonEncode3(const uint64_t x, const uint64_t y,
+                              const uint64_t z) {
+  return mortonSplit3(x) | (mortonSplit3(y) << 1) | (mortonSplit3(z) << 2);
+}
+
+/// Splits a Morton code back into its coordinates
+inline void mortonDecode3(const uint64_t code, uint64_t& x, uint64_t& y,
+                          uint64_t& z) {
+  x = mortonCompact3(code);
+  y = mortonCompact3(code >> 1);
+  z = mortonCompact3(code >> 2);
+}
+
+#endif // _MORTON_H_
@@ -0,0 +1,110 @@
+#include <normalEstimation.h>
+#include <linearAlgebra.h>
+
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+NormalEstimation::NormalEstimation(const size_t & _numNeighbors)
+  : numNeighbors(_numNeighbors) {
+  if(numNeighbors < 3) throwRuntimeError("Need at least 3 neighbors");
+  viewpoint[0] = viewpoint[1] = viewpoint[2] = 0.0f;
+}
+
+/// Writes the normals of points to nx, ny, nz
+void NormalEstimation::compute(Points& points,
+                               std::vector<float>* curvature) const {
+  if(curvature) curvature->resize(points.size());
+  computeAll(XYZView(points),
+             [&points, curvature](const size_t i, const float normal[3],
+                                  const float c) {
+               points[i].nx = normal[0];
+               points[i].ny = normal[1];
+               points[i].nz = normal[2];
+               if(curvature) (*curvature)[i] = c;
+             });
+}
+
+/// Same for a structure of arrays cloud, normals are added if absent
+void NormalEstimation::compute(PointCloud& cloud,
+                               std::vector<float>* curvature) const {
+  if(!cloud.hasNormals())
+    cloud.setAttributes(true, cloud.hasColors(), cloud.hasFlags());
+  if(curvature) curvature->resize(cloud.size());
+  computeAll(XYZView(cloud),
+             [&cloud, curvature](const size_t i, const float normal[3],
+                                 const float c) {
+               cloud.nx[i] = normal[0];
+               cloud.ny[i] = normal[1];
+               cloud.nz[i] = normal[2];
+               if(curvature) (*curvature)[i] = c;
+             });
+}
+
+template <typename Store>
+void NormalEstimation::computeAll(const XYZView& points,
+                                  const Store& store) const {
+  const size_t n(points.size());
+  if(n == 0) return;
+  KdTree tree;
+  tree.build(points);
+
+#ifdef USE_OpenMP
+  #pragma omp parallel
+#endif
+  {
+    std::vector<uint32_t> ids(numNeighbors);
+    std::vector<float> sqrDistances(numNeighbors);
+#ifdef USE_OpenMP
+    #pragma omp for schedule(dynamic, 256)
+#endif
+    for(size_t i = 0; i < n; i++) {
+      const size_t found(tree.knn(points.getX(i), points.getY(i),
+                                  points.getZ(i), numNeighbors, ids.data(),
+                                  sqrDistances.data()));
+      float normal[3], curvature;
+      estimate(points, i, ids.data(), found, normal, curvature);
+      store(i, normal, curvature);
+    }
+  }
+}
+
+/// normal and curvature of point i from its neighbors ids[0..n)
+void NormalEstimation::estimate(const XYZView& points, const size_t i,
+                                const uint32_t* ids, const size_t n,
+                                float normal[3], float& curvature) const {
+  normal[0] = normal[1] = normal[2] = 0.0f;
+  curvature = 0.0f;
+  if(n < 3) return;
+
+  // relative to the point itself, large coordinates would cancel
+  const double px(points.getX(i)), py(points.getY(i)), pz(points.getZ(i));
+  double sx = 0.0, sy = 0.0, sz = 0.0;
+  double sxx = 0.0, sxy = 0.0, sxz = 0.0, syy = 0.0, syz = 0.0, szz = 0.0;
+  for(size_t j = 0; j < n; j++) {
+    const double x(points.getX(ids[j]) - px);
+    const double y(points.getY(ids[j]) - py);
+    const double z(points.getZ(ids[j]) - pz);
+    sx += x; sy += y; sz += z;
+    sxx += x * x; sxy += x * y; sxz += x * z;
+    syy += y * y; syz += y * z; szz += z * z;
+  }
+  const double inv(1.0 / n);
+  const double mx(sx * inv), my(sy * inv), mz(sz * inv);
+  const double covariance[6] = {sxx * inv - mx * mx, sxy * inv - mx * my,
+                                sxz * inv - mx * mz, syy * inv - my * my,
+                                syz * inv - my * mz, szz * inv - mz * mz};
+  double eigenvalues[3], eigenvectors[3][3];
+  linalg::symmetricEigen3(covariance, eigenvalues, eigenvectors);
+
+  // face the viewpoint
+  const double* v = eigenvectors[0];
+  const double toView((viewpoint[0] - px) * v[0] + (viewpoint[1] - py) * v[1]
+                      + (viewpoint[2] - pz) * v[2]);
+  const double sign(toView < 0.0 ? -1.0 : 1.0);
+  for(int a = 0; a < 3; a++) normal[a] = static_cast<float>(sign * v[a]);
+
+  const double sum(eigenvalues[0] + eigenvalues[1] + eigenvalues[2]);
+  curvature = sum > 0.0 ? static_cast<float>(
+      std::max(0.0, eigenvalues[0]) / sum) : 0.0f;
+}
@@ -0,0 +1,57 @@
+#ifndef _NORMAL_ESTIMATION_H_
+#define _NORMAL_ESTIMATION_H_
+
+// STL
+#include <cstdint>
+#include <vector>
+
+// 3DL headers
+#include <common.h>
+#include <pointCloud.h>
+#include <kdTree.h>
+
+/** \class NormalEstimation
+  * \brief Estimates point normals from the covariance of their neighbors.
+  *
+  * For every point the k nearest neighbors are found with a KdTree, the
+  * normal is the eigenvector of the smallest eigenvalue of their
+  * covariance, taken from the closed form solver in linearAlgebra.h, and
+  * is flipped to face the viewpoint. Runs in parallel over points. Points
+  * with less than three neighbors get a zero normal.
+  */
+class NormalEstimation {
+  protected:
+    const size_t              numNeighbors;
+    float                     viewpoint[3];
+
+  public:
+    NormalEstimation(const size_t & _numNeighbors = 16);
+
+    /// Normals are oriented towards this point, the origin by default
+    void setViewpoint(const float x, const float y, const float z) {
+      viewpoint[0] = x; viewpoint[1] = y; viewpoint[2] = z;
+    }
+
+    /** Writes the normals of points to nx, ny, nz
+     *
+     *  If curvature isnt null it receives the surface variation
+     *  l0 / (l0 + l1 + l2) of every point, l0 the smallest eigenvalue.
+     */
+    void compute(Points& points, std::vector<float>* curvature = nullptr) const;
+
+    /// Same for a structure of arrays cloud, normals are added if absent
+    void compute(PointCloud& cloud,
+                 std::vector<float>* curvature = nullptr) const;
+
+  protected:
+    /// normal and curvature of point i from its neighbors ids[0..n)
+    void estimate(const XYZView& points, const size_t i, const uint32_t* ids,
+                  const size_t n, float normal[3], float& curvature) const;
+
+    /// runs estimate for every point, store(i, normal, curvature) writes
+    /// the result
+    template <typename Store>
+    void computeAll(const XYZView& points, const Store& store) const;
+}; // class NormalEstimation
+
+#endif // _NORMAL_ESTIMATION_H_
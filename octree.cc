@@ -0,0 +1,230 @@
+#include <octree.h>
+#include <radixSort.h>
+
+#include <cmath>
+#include <limits>
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+const int LinearOctree::kMaxDepth;
+
+LinearOctree::LinearOctree(const int & _depth)
+  : depth(_depth), size(1.0f) {
+  if(depth < 1 || depth > kMaxDepth)
+    throwRuntimeError("Octree depth has to be in [1, 10]");
+  origin[0] = origin[1] = origin[2] = 0.0f;
+}
+
+/// Computes the codes of the points and sorts them by code
+void LinearOctree::build(Points& points) {
+  const size_t n(points.size());
+  if(n > std::numeric_limits<uint32_t>::max())
+    throwRuntimeError("Too many points for the octree");
+  codes.clear();
+  order.clear();
+  if(n == 0) return;
+
+  // root cube over the bounds
+  float x0 = std::numeric_limits<float>::max();
+  float y0 = std::numeric_limits<float>::max();
+  float z0 = std::numeric_limits<float>::max();
+  float x1 = std::numeric_limits<float>::lowest();
+  float y1 = std::numeric_limits<float>::lowest();
+  float z1 = std::numeric_limits<float>::lowest();
+#ifdef USE_OpenMP
+  #pragma omp parallel for reduction(min:x0,y0,z0) reduction(max:x1,y1,z1)
+#endif
+  for(size_t i = 0; i < n; i++) {
+    const Point& p = points[i];
+    x0 = std::min(x0, p.x); y0 = std::min(y0, p.y); z0 = std::min(z0, p.z);
+    x1 = std::max(x1, p.x); y1 = std::max(y1, p.y); z1 = std::max(z1, p.z);
+  }
+  origin[0] = x0; origin[1] = y0; origin[2] = z0;
+  size = std::max(x1 - x0, std::max(y1 - y0, z1 - z0));
+  if(!(size > 0.0f)) size = 1.0f;
+
+  // Morton code of every point's leaf cell
+  const uint64_t cells(uint64_t(1) << depth);
+  const float scale(float(cells) / size);
+  std::vector<uint64_t> keys(n);
+  order.resize(n);
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for(size_t i = 0; i < n; i++) {
+    Point& p = points[i];
+    const uint64_t x(std::min<uint64_t>(cells - 1, static_cast<uint64_t>(
+        std::max(0.0f, (p.x - origin[0]) * scale))));
+    const uint64_t y(std::min<uint64_t>(cells - 1, static_cast<uint64_t>(
+        std::max(0.0f, (p.y - origin[1]) * scale))));
+    const uint64_t z(std::min<uint64_t>(cells - 1, static_cast<uint64_t>(
+        std::max(0.0f, (p.z - origin[2]) * scale))));
+    keys[i] = mortonEncode3(x, y, z);
+    p.octreeCode = static_cast<unsigned int>(keys[i]);
+    order[i] = static_cast<uint32_t>(i);
+  }
+  radixSortPairs(keys, order, 3 * depth);
+
+  // reorder the points
+  Points sorted(n);
+  codes.resize(n);
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for(size_t i = 0; i < n; i++) {
+    sorted[i] = points[order[i]];
+    codes[i] = static_cast<uint32_t>(keys[i]);
+  }
+  points.swap(sorted);
+}
+
+/// Range [begin, end) of the points in the node code at level
+void LinearOctree::nodeRange(const int level, const uint32_t code,
+                             size_t& begin, size_t& end) const {
+  childRange(level, code, 0, codes.size(), begin, end);
+}
+
+void LinearOctree::childRange(const int level, const uint32_t code,
+                              const size_t begin, const size_t end,
+                              size_t& childBegin, size_t& childEnd) const {
+  const int shift(3 * (depth - level));
+  const uint32_t first(code << shift);
+  const uint32_t last(((code + 1) << shift) - 1);
+  childBegin = std::lower_bound(codes.begin() + begin, codes.begin() + end,
+                                first) - codes.begin();
+  childEnd = std::upper_bound(codes.begin() + childBegin, codes.begin() + end,
+                              last) - codes.begin();
+}
+
+/// Axis aligned bounds of the node code at level
+void LinearOctree::nodeBounds(const int level, const uint32_t code,
+                              float min[3], float max[3]) const {
+  uint64_t c[3];
+  mortonDecode3(code, c[0], c[1], c[2]);
+  const float s(nodeSize(level));
+  for(int a = 0; a < 3; a++) {
+    min[a] = origin[a] + c[a] * s;
+    max[a] = origin[a] + (c[a] + 1) * s;
+  }
+}
+
+/// Codes of the non empty nodes at level, ascending
+void LinearOctree::nodes(const int level, std::vector<uint32_t>& result) const {
+  result.clear();
+  for(size_t i = 0; i < codes.size();) {
+    const uint32_t code(nodeCode(i, level));
+    result.push_back(code);
+    // skip the rest of the node
+    size_t begin, end;
+    childRange(level, code, i, codes.size(), begin, end);
+    i = end;
+  }
+}
+
+/// Codes of the non empty nodes at level sharing a face, edge or corner
+/// with the node code
+void LinearOctree::neighbors(const int level, const uint32_t code,
+                             std::vector<uint32_t>& result) const {
+  result.clear();
+  uint64_t c[3];
+  mortonDecode3(code, c[0], c[1], c[2]);
+  const int64_t cells(int64_t(1) << level);
+  for(int dz = -1; dz <= 1; dz++) {
+    for(int dy = -1; dy <= 1; dy++) {
+      for(int dx = -1; dx <= 1; dx++) {
+        if(!dx && !dy && !dz) continue;
+        const int64_t x(c[0] + dx), y(c[1] + dy), z(c[2] + dz);
+        if(x < 0 || y < 0 || z < 0 || x >= cells || y >= cells || z >= cells)
+          continue;
+        const uint32_t neighbor(static_cast<uint32_t>(
+            mortonEncode3(x, y, z)));
+        size_t begin, end;
+        nodeRange(level, neighbor, begin, end);
+        if(begin != end) result.push_back(neighbor);
+      }
+    }
+  }
+}
+
+/// Indices of the points inside the box [min, max]
+void LinearOctree::boxQuery(const Points& points, const float min[3],
+                            const float max[3],
+                            std::vector<uint32_t>& result) const {
+  result.clear();
+  boxQuery(points, min, max, 0, 0, 0, codes.size(), result);
+}
+
+void LinearOctree::boxQuery(const Points& points, const float min[3],
+                            const float max[3], const int level,
+                            const uint32_t code, const size_t begin,
+                            const size_t end,
+                            std::vector<uint32_t>& result) const {
+  if(begin == end) return;
+  float lo[3], hi[3];
+  nodeBounds(level, code, lo, hi);
+  // quantization rounds, a point can be off its cell by a few ulp of the
+  // root size, so nodes are only taken whole with some margin
+  const float margin(size * 1e-6f);
+  bool inside(true);
+  for(int a = 0; a < 3; a++) {
+    if(hi[a] + margin < min[a] || lo[a] - margin > max[a]) return;
+    inside = inside && lo[a] - margin >= min[a] && hi[a] + margin <= max[a];
+  }
+  if(inside) {
+    for(size_t i = begin; i < end; i++) result.push_back(i);
+    return;
+  }
+  if(level == depth) {
+    for(size_t i = begin; i < end; i++) {
+      const Point& p = points[i];
+      if(p.x >= min[0] && p.x <= max[0] && p.y >= min[1] && p.y <= max[1]
+          && p.z >= min[2] && p.z <= max[2])
+        result.push_back(i);
+    }
+    return;
+  }
+  size_t childBegin = begin;
+  for(uint32_t c = 0; c < 8; c++) {
+    const uint32_t child((code << 3) | c);
+    size_t first, last;
+    childRange(level + 1, child, childBegin, end, first, last);
+    boxQuery(points, min, max, level + 1, child, first, last, result);
+    childBegin = last;
+  }
+}
+
+/// Index of the point closest to the center of every non empty node at
+/// level, ordered by node code
+void LinearOctree::levelOfDetail(const Points& points, const int level,
+                                 std::vector<uint32_t>& result) const {
+  std::vector<uint32_t> nodeCodes;
+  nodes(level, nodeCodes);
+  result.resize(nodeCodes.size());
+
+  const int64_t numNodes(nodeCodes.size());
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(dynamic, 256)
+#endif
+  for(int64_t k = 0; k < numNodes; k++) {
+    float lo[3], hi[3];
+    nodeBounds(level, nodeCodes[k], lo, hi);
+    const float cx(0.5f * (lo[0] + hi[0]));
+    const float cy(0.5f * (lo[1] + hi[1]));
+    const float cz(0.5f * (lo[2] + hi[2]));
+    size_t begin, end;
+    nodeRange(level, nodeCodes[k], begin, end);
+    size_t best(begin);
+    float bestDistance(std::numeric_limits<float>::max());
+    for(size_t i = begin; i < end; i++) {
+      const Point& p = points[i];
+      const float d((p.x - cx) * (p.x - cx) + (p.y - cy) * (p.y - cy)
+                    + (p.z - cz) * (p.z - cz));
+      if(d < bestDistance) {
+        bestDistance = d;
+        best = i;
+      }
+    }
+    result[k] = static_cast<uint32_t>(best);
+  }
+}
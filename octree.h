@@ -0,0 +1,98 @@
+#ifndef _OCTREE_H_
+#define _OCTREE_H_
+
+// STL
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+// 3DL headers
+#include <common.h>
+#include <morton.h>
+
+/** \class LinearOctree
+  * \brief Pointer free octree over a cloud sorted by Morton code.
+  *
+  * build quantizes the points on a cube of 2^depth cells per axis, stores
+  * the Morton code of every point's cell in Point::octreeCode and sorts the
+  * points by it. A node at level l is then the prefix code >> 3 * (depth -
+  * l) and its points are one contiguous range, found by binary search in
+  * the sorted codes. No node objects are allocated, the index is the code
+  * array.
+  */
+class LinearOctree {
+  public:
+    /// deepest level whose codes fit Point::octreeCode
+    static const int          kMaxDepth = 10;
+
+  private:
+    const int                 depth;
+    float                     origin[3]; ///< min corner of the root cube
+    float                     size; ///< side length of the root cube
+    std::vector<uint32_t>     codes; ///< codes of the sorted points
+    std::vector<uint32_t>     order; ///< original index of every point
+
+  public:
+    LinearOctree(const int & _depth = kMaxDepth);
+
+    /** Computes the codes of the points and sorts them by code
+     *
+     *  points is reordered in place, replacing any previous build. The
+     *  queries below take the same, unmodified points.
+     */
+    void build(Points& points);
+
+    inline int getDepth() const { return depth; }
+    inline size_t numPoints() const { return codes.size(); }
+
+    /// original index of the point now at position i
+    inline const std::vector<uint32_t>& permutation() const { return order; }
+
+    /// side length of the nodes at level
+    inline float nodeSize(const int level) const {
+      return size / float(uint32_t(1) << level);
+    }
+
+    /// code of the node at level containing point i
+    inline uint32_t nodeCode(const size_t i, const int level) const {
+      return codes[i] >> (3 * (depth - level));
+    }
+
+    /// Range [begin, end) of the points in the node code at level
+    void nodeRange(const int level, const uint32_t code, size_t& begin,
+                   size_t& end) const;
+
+    /// Axis aligned bounds of the node code at level
+    void nodeBounds(const int level, const uint32_t code, float min[3],
+                    float max[3]) const;
+
+    /// Codes of the non empty nodes at level, ascending
+    void nodes(const int level, std::vector<uint32_t>& result) const;
+
+    /// Codes of the non empty nodes at level sharing a face, edge or
+    /// corner with the node code
+    void neighbors(const int level, const uint32_t code,
+                   std::vector<uint32_t>& result) const;
+
+    /// Indices of the points inside the box [min, max]
+    void boxQuery(const Points& points, const float min[3],
+                  const float max[3], std::vector<uint32_t>& result) const;
+
+    /// Index of the point closest to the center of every non empty node at
+    /// level, ordered by node code
+    void levelOfDetail(const Points& points, const int level,
+                       std::vector<uint32_t>& result) const;
+
+  private:
+    /// range of child within the range [begin, end) of its parent
+    void childRange(const int level, const uint32_t code, const size_t begin,
+                    const size_t end, size_t& childBegin,
+                    size_t& childEnd) const;
+
+    void boxQuery(const Points& points, const float min[3],
+                  const float max[3], const int level, const uint32_t code,
+                  const size_t begin, const size_t end,
+                  std::vector<uint32_t>& result) const;
+}; // class LinearOctree
+
+#endif // _OCTREE_H_
@@ -0,0 +1,228 @@
+#include <planeKernels.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PLANE_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+void PointBlock::gather(const Points& points, const uint32_t* ids,
+                        const size_t n) {
+  for(size_t i = 0; i < n; i++) {
+    const Point& p = points[ids[i]];
+    x[i] = p.x;
+    y[i] = p.y;
+    z[i] = p.z;
+    nx[i] = p.nx;
+    ny[i] = p.ny;
+    nz[i] = p.nz;
+  }
+  count = n;
+}
+
+namespace {
+
+// ----------------------------------------------------------------------------
+// scalar kernels, also handle the tails of the vector kernels
+// ----------------------------------------------------------------------------
+
+void distancesScalar(const PointBlock& block, const Plane& plane,
+                     float* distances, const size_t begin) {
+  for(size_t i = begin; i < block.count; i++)
+    distances[i] = ((plane.nx * block.x[i]) + (plane.ny * block.y[i])
+                    + (plane.nz * block.z[i])) - plane.d;
+}
+
+size_t inliersScalar(const PointBlock& block, const Plane& plane,
+                     const PlaneInlierTest& test, uint8_t* mask,
+                     const size_t begin) {
+  size_t count = 0;
+  for(size_t i = begin; i < block.count; i++) {
+    const bool inlier(test.isInlier(plane, block.x[i], block.y[i], block.z[i],
+                                    block.nx[i], block.ny[i], block.nz[i]));
+    if(mask) mask[i] = inlier;
+    count += inlier;
+  }
+  return count;
+}
+
+void distancesGeneric(const PointBlock& block, const Plane& plane,
+                      float* distances) {
+  distancesScalar(block, plane, distances, 0);
+}
+
+size_t inliersGeneric(const PointBlock& block, const Plane& plane,
+                      const PlaneInlierTest& test, uint8_t* mask) {
+  return inliersScalar(block, plane, test, mask, 0);
+}
+
+#ifdef PLANE_KERNELS_X86
+// ----------------------------------------------------------------------------
+// vector kernels. Same operations in the same order as the scalar
+// reference and no fused multiply add, so every instruction set classifies
+// every point the same way.
+// ----------------------------------------------------------------------------
+
+__attribute__((target("sse2")))
+void distancesSSE(const PointBlock& block, const Plane& plane,
+                  float* distances) {
+  const __m128 px(_mm_set1_ps(plane.nx)), py(_mm_set1_ps(plane.ny));
+  const __m128 pz(_mm_set1_ps(plane.nz)), pd(_mm_set1_ps(plane.d));
+  size_t i = 0;
+  for(; i + 4 <= block.count; i += 4) {
+    const __m128 dot(_mm_add_ps(_mm_add_ps(
+        _mm_mul_ps(px, _mm_load_ps(block.x + i)),
+        _mm_mul_ps(py, _mm_load_ps(block.y + i))),
+        _mm_mul_ps(pz, _mm_load_ps(block.z + i))));
+    _mm_storeu_ps(distances + i, _mm_sub_ps(dot, pd));
+  }
+  distancesScalar(block, plane, distances, i);
+}
+
+__attribute__((target("sse2")))
+size_t inliersSSE(const PointBlock& block, const Plane& plane,
+                  const PlaneInlierTest& test, uint8_t* mask) {
+  const __m128 px(_mm_set1_ps(plane.nx)), py(_mm_set1_ps(plane.ny));
+  const __m128 pz(_mm_set1_ps(plane.nz)), pd(_mm_set1_ps(plane.d));
+  const __m128 maxDistance(_mm_set1_ps(test.maxDistance));
+  const __m128 minCos(_mm_set1_ps(test.minCos));
+  const __m128 maxDifference(_mm_set1_ps(0.01f));
+  const __m128 absMask(_mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+
+  size_t count = 0;
+  size_t i = 0;
+  for(; i + 4 <= block.count; i += 4) {
+    const __m128 distance(_mm_sub_ps(_mm_add_ps(_mm_add_ps(
+        _mm_mul_ps(px, _mm_load_ps(block.x + i)),
+        _mm_mul_ps(py, _mm_load_ps(block.y + i))),
+        _mm_mul_ps(pz, _mm_load_ps(block.z + i))), pd));
+    const __m128 nx(_mm_load_ps(block.nx + i));
+    const __m128 ny(_mm_load_ps(block.ny + i));
+    const __m128 nz(_mm_load_ps(block.nz + i));
+    const __m128 cosine(_mm_add_ps(_mm_add_ps(
+        _mm_mul_ps(px, nx), _mm_mul_ps(py, ny)), _mm_mul_ps(pz, nz)));
+    const __m128 dx(_mm_sub_ps(px, nx));
+    const __m128 dy(_mm_sub_ps(py, ny));
+    const __m128 dz(_mm_sub_ps(pz, nz));
+    const __m128 difference(_mm_add_ps(_mm_add_ps(
+        _mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+
+    const __m128 inlier(_mm_and_ps(
+        _mm_cmplt_ps(_mm_and_ps(distance, absMask), maxDistance),
+        _mm_or_ps(_mm_cmpgt_ps(_mm_and_ps(cosine, absMask), minCos),
+                  _mm_cmplt_ps(difference, maxDifference))));
+    const int bits(_mm_movemask_ps(inlier));
+    count += __builtin_popcount(bits);
+    if(mask)
+      for(int k = 0; k < 4; k++) mask[i + k] = (bits >> k) & 1;
+  }
+  return count + inliersScalar(block, plane, test, mask, i);
+}
+
+__attribute__((target("avx2")))
+void distancesAVX2(const PointBlock& block, const Plane& plane,
+                   float* distances) {
+  const __m256 px(_mm256_set1_ps(plane.nx)), py(_mm256_set1_ps(plane.ny));
+  const __m256 pz(_mm256_set1_ps(plane.nz)), pd(_mm256_set1_ps(plane.d));
+  size_t i = 0;
+  for(; i + 8 <= block.count; i += 8) {
+    const __m256 dot(_mm256_add_ps(_mm256_add_ps(
+        _mm256_mul_ps(px, _mm256_load_ps(block.x + i)),
+        _mm256_mul_ps(py, _mm256_load_ps(block.y + i))),
+        _mm256_mul_ps(pz, _mm256_load_ps(block.z + i))));
+    _mm256_storeu_ps(distances + i, _mm256_sub_ps(dot, pd));
+  }
+  distancesScalar(block, plane, distances, i);
+}
+
+__attribute__((target("avx2")))
+size_t inliersAVX2(const PointBlock& block, const Plane& plane,
+                   const PlaneInlierTest& test, uint8_t* mask) {
+  const __m256 px(_mm256_set1_ps(plane.nx)), py(_mm256_set1_ps(plane.ny));
+  const __m256 pz(_mm256_set1_ps(plane.nz)), pd(_mm256_set1_ps(plane.d));
+  const __m256 maxDistance(_mm256_set1_ps(test.maxDistance));
+  const __m256 minCos(_mm256_set1_ps(test.minCos));
+  const __m256 maxDifference(_mm256_set1_ps(0.01f));
+  const __m256 absMask(_mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)));
+
+  size_t count = 0;
+  size_t i = 0;
+  for(; i + 8 <= block.count; i += 8) {
+    const __m256 distance(_mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(
+        _mm256_mul_ps(px, _mm256_load_ps(block.x + i)),
+        _mm256_mul_ps(py, _mm256_load_ps(block.y + i))),
+        _mm256_mul_ps(pz, _mm256_load_ps(block.z + i))), pd));
+    const __m256 nx(_mm256_load_ps(block.nx + i));
+    const __m256 ny(_mm256_load_ps(block.ny + i));
+    const __m256 nz(_mm256_load_ps(block.nz + i));
+    const __m256 cosine(_mm256_add_ps(_mm256_add_ps(
+        _mm256_mul_ps(px, nx), _mm256_mul_ps(py, ny)),
+        _mm256_mul_ps(pz, nz)));
+    const __m256 dx(_mm256_sub_ps(px, nx));
+    const __m256 dy(_mm256_sub_ps(py, ny));
+    const __m256 dz(_mm256_sub_ps(pz, nz));
+    const __m256 difference(_mm256_add_ps(_mm256_add_ps(
+        _mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+        _mm256_mul_ps(dz, dz)));
+
+    const __m256 inlier(_mm256_and_ps(
+        _mm256_cmp_ps(_mm256_and_ps(distance, absMask), maxDistance,
+                      _CMP_LT_OQ),
+        _mm256_or_ps(
+            _mm256_cmp_ps(_mm256_and_ps(cosine, absMask), minCos,
+                          _CMP_GT_OQ),
+            _mm256_cmp_ps(difference, maxDifference, _CMP_LT_OQ))));
+    const int bits(_mm256_movemask_ps(inlier));
+    count += __builtin_popcount(bits);
+    if(mask)
+      for(int k = 0; k < 8; k++) mask[i + k] = (bits >> k) & 1;
+  }
+  return count + inliersScalar(block, plane, test, mask, i);
+}
+#endif // PLANE_KERNELS_X86
+
+// ----------------------------------------------------------------------------
+// runtime dispatch
+// ----------------------------------------------------------------------------
+
+struct Kernels {
+  void (*distances)(const PointBlock&, const Plane&, float*);
+  size_t (*inliers)(const PointBlock&, const Plane&, const PlaneInlierTest&,
+                    uint8_t*);
+  const char* isa;
+};
+
+Kernels selectKernels() {
+#ifdef PLANE_KERNELS_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))
+    return Kernels{distancesAVX2, inliersAVX2, "avx2"};
+  if(__builtin_cpu_supports("sse2"))
+    return Kernels{distancesSSE, inliersSSE, "sse2"};
+#endif
+  return Kernels{distancesGeneric, inliersGeneric, "scalar"};
+}
+
+const Kernels& kernels() {
+  static const Kernels selected(selectKernels());
+  return selected;
+}
+
+} // namespace
+
+/// Writes the signed distances of the block points to plane to distances
+void planeDistances(const PointBlock& block, const Plane& plane,
+                    float* distances) {
+  kernels().distances(block, plane, distances);
+}
+
+/// Counts the inliers of plane in block, if mask isnt null it receives 1
+/// for every inlier and 0 for every other point
+size_t planeInliers(const PointBlock& block, const Plane& plane,
+                    const PlaneInlierTest& test, uint8_t* mask) {
+  return kernels().inliers(block, plane, test, mask);
+}
+
+/// Name of the instruction set the kernels use on this cpu
+const char* planeKernelsIsa() {
+  return kernels().isa;
+}
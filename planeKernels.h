@@ -0,0 +1,82 @@
+#ifndef _PLANE_KERNELS_H_
+#define _PLANE_KERNELS_H_
+
+// STL
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// 3DL headers
+#include <common.h>
+#include <types.h>
+
+/** \struct PointBlock
+  * \brief Coordinates and normals of up to kSize points, structure of arrays.
+  *
+  * The batch kernels below run on blocks, so points picked through an index
+  * list are gathered once and then tested against several planes with
+  * aligned vector loads.
+  */
+struct PointBlock {
+  static const size_t kSize = 256;
+
+  alignas(32) float x[kSize];
+  alignas(32) float y[kSize];
+  alignas(32) float z[kSize];
+  alignas(32) float nx[kSize];
+  alignas(32) float ny[kSize];
+  alignas(32) float nz[kSize];
+  size_t            count = 0;
+
+  /// Copies the points ids[0..n) of points, n <= kSize
+  void gather(const Points& points, const uint32_t* ids, const size_t n);
+};
+
+/** \struct PlaneInlierTest
+  * \brief Inlier test of points against a plane with precomputed thresholds.
+  *
+  * A point is an inlier if it is closer than maxDistance to the plane and
+  * its normal is within maxAngle degrees of the plane normal, ignoring the
+  * orientation. The angle is compared through its cosine, so no acos is
+  * needed per point. As before, normals that differ by less than 0.1 count
+  * as parallel.
+  */
+struct PlaneInlierTest {
+  float             maxDistance;
+  float             minCos; ///< cosine of maxAngle
+
+  PlaneInlierTest(const float& _maxDistance, const float& maxAngle)
+    : maxDistance(_maxDistance),
+      minCos(std::cos(maxAngle * float(M_PI / 180.0))) {}
+
+  /// scalar reference, every kernel makes the same decisions
+  inline bool isInlier(const Plane& plane, const float x, const float y,
+                       const float z, const float nx, const float ny,
+                       const float nz) const {
+    const float distance(((plane.nx * x) + (plane.ny * y) + (plane.nz * z))
+                         - plane.d);
+    const float cosine((plane.nx * nx) + (plane.ny * ny) + (plane.nz * nz));
+    const float dx(plane.nx - nx), dy(plane.ny - ny), dz(plane.nz - nz);
+    const float difference((dx * dx) + (dy * dy) + (dz * dz));
+    return std::abs(distance) < maxDistance &&
+           (std::abs(cosine) > minCos || difference < 0.01f);
+  }
+
+  inline bool isInlier(const Plane& plane, const Point& p) const {
+    return isInlier(plane, p.x, p.y, p.z, p.nx, p.ny, p.nz);
+  }
+};
+
+/// Writes the signed distances of the block points to plane to distances
+void planeDistances(const PointBlock& block, const Plane& plane,
+                    float* distances);
+
+/// Counts the inliers of plane in block, if mask isnt null it receives 1
+/// for every inlier and 0 for every other point
+size_t planeInliers(const PointBlock& block, const Plane& plane,
+                    const PlaneInlierTest& test, uint8_t* mask = nullptr);
+
+/// Name of the instruction set the kernels use on this cpu
+const char* planeKernelsIsa();
+
+#endif // _PLANE_KERNELS_H_
@@ -30,6 +30,423 @@
 
 
 #include "plyIO.h"
+#include "morton.h"
+#include "radixSort.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PLYIO_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ----------------------------------------------------------------------------
+// PlyVertexLayout
+// ----------------------------------------------------------------------------
+
+namespace {
+
+template <typename T>
+inline T loadScalar(const char* src) {
+  T data;
+  std::memcpy(&data, src, sizeof(T));
+  return data;
+}
+
+/// decodes one vertex record, the properties present are compile time flags
+template <bool kNormals, bool kColors, bool kAlpha, bool kFlags>
+inline void decodeVertexRecord(const char* rec, const int* offsets, Point& v) {
+  v.x = loadScalar<float>(rec + offsets[PlyPropertyTypes::kX]);
+  v.y = loadScalar<float>(rec + offsets[PlyPropertyTypes::kY]);
+  v.z = loadScalar<float>(rec + offsets[PlyPropertyTypes::kZ]);
+  if(kNormals) {
+    v.nx = loadScalar<float>(rec + offsets[PlyPropertyTypes::kNX]);
+    v.ny = loadScalar<float>(rec + offsets[PlyPropertyTypes::kNY]);
+    v.nz = loadScalar<float>(rec + offsets[PlyPropertyTypes::kNZ]);
+  }
+  if(kColors) {
+    v.r = static_cast<uint8_t>(rec[offsets[PlyPropertyTypes::kR]]);
+    v.g = static_cast<uint8_t>(rec[offsets[PlyPropertyTypes::kG]]);
+    v.b = static_cast<uint8_t>(rec[offsets[PlyPropertyTypes::kB]]);
+  }
+  if(kAlpha)
+    v.a = static_cast<uint8_t>(rec[offsets[PlyPropertyTypes::kA]]);
+  if(kFlags)
+    v.flags = loadScalar<int32_t>(rec + offsets[PlyPropertyTypes::kFlags]);
+}
+
+template <bool kNormals, bool kColors, bool kAlpha, bool kFlags>
+void decodeVertexRecords(const char* src, size_t count,
+                         const PlyVertexLayout& layout, Point* dst) {
+  const size_t stride(layout.stride);
+  for(size_t i = 0; i < count; i++, src += stride)
+    decodeVertexRecord<kNormals, kColors, kAlpha, kFlags>(
+        src, layout.offsets, dst[i]);
+}
+
+template <typename T>
+inline void storeScalar(char* dst, const T data) {
+  std::memcpy(dst, &data, sizeof(T));
+}
+
+/// encodes one vertex record, the properties present are compile time flags
+template <bool kNormals, bool kColors, bool kAlpha, bool kFlags>
+inline void encodeVertexRecord(const Point& v, const int* offsets, char* rec) {
+  storeScalar<float>(rec + offsets[PlyPropertyTypes::kX], v.x);
+  storeScalar<float>(rec + offsets[PlyPropertyTypes::kY], v.y);
+  storeScalar<float>(rec + offsets[PlyPropertyTypes::kZ], v.z);
+  if(kNormals) {
+    storeScalar<float>(rec + offsets[PlyPropertyTypes::kNX], v.nx);
+    storeScalar<float>(rec + offsets[PlyPropertyTypes::kNY], v.ny);
+    storeScalar<float>(rec + offsets[PlyPropertyTypes::kNZ], v.nz);
+  }
+  if(kColors) {
+    rec[offsets[PlyPropertyTypes::kR]] = static_cast<char>(v.r);
+    rec[offsets[PlyPropertyTypes::kG]] = static_cast<char>(v.g);
+    rec[offsets[PlyPropertyTypes::kB]] = static_cast<char>(v.b);
+  }
+  if(kAlpha)
+    rec[offsets[PlyPropertyTypes::kA]] = static_cast<char>(v.a);
+  if(kFlags)
+    storeScalar<int32_t>(rec + offsets[PlyPropertyTypes::kFlags], v.flags);
+}
+
+template <bool kNormals, bool kColors, bool kAlpha, bool kFlags>
+void encodeVertexRecords(const Point* src, size_t count,
+                         const PlyVertexLayout& layout, char* dst) {
+  const size_t stride(layout.stride);
+  for(size_t i = 0; i < count; i++, dst += stride)
+    encodeVertexRecord<kNormals, kColors, kAlpha, kFlags>(
+        src[i], layout.offsets, dst);
+}
+
+/// fallback for layouts without a specialisation, dispatches per property
+void encodeVertexRecordsGeneric(const Point* src, size_t count,
+                                const PlyVertexLayout& layout, char* dst) {
+  for(size_t i = 0; i < count; i++, dst += layout.stride) {
+    const Point & v = src[i];
+    for(const PlyVertexLayout::Field & field : layout.fields) {
+      float value = 0.0f;
+      uint32_t bits = 0;
+      switch (field.propertyType) {
+        case PlyPropertyTypes::kX:     value = v.x;  break;
+        case PlyPropertyTypes::kY:     value = v.y;  break;
+        case PlyPropertyTypes::kZ:     value = v.z;  break;
+        case PlyPropertyTypes::kNX:    value = v.nx; break;
+        case PlyPropertyTypes::kNY:    value = v.ny; break;
+        case PlyPropertyTypes::kNZ:    value = v.nz; break;
+        case PlyPropertyTypes::kR:     bits = v.r; break;
+        case PlyPropertyTypes::kG:     bits = v.g; break;
+        case PlyPropertyTypes::kB:     bits = v.b; break;
+        case PlyPropertyTypes::kA:     bits = v.a; break;
+        case PlyPropertyTypes::kFlags: bits = v.flags; break;
+        default: break;
+      }
+      if(field.propertyType <= PlyPropertyTypes::kNZ)
+        std::memcpy(&bits, &value, sizeof(float));
+      // properties narrower than the source are truncated
+      std::memcpy(dst + field.offset, &bits, field.size);
+    }
+  }
+}
+
+/// fallback for layouts without a specialisation, dispatches per property
+void decodeVertexRecordsGeneric(const char* src, size_t count,
+                                const PlyVertexLayout& layout, Point* dst) {
+  for(size_t i = 0; i < count; i++, src += layout.stride) {
+    Point & v = dst[i];
+    for(const PlyVertexLayout::Field & field : layout.fields) {
+      // properties narrower than the destination are zero extended
+      uint32_t bits = 0;
+      std::memcpy(&bits, src + field.offset, field.size);
+      float value;
+      std::memcpy(&value, &bits, sizeof(float));
+      switch (field.propertyType) {
+        case PlyPropertyTypes::kX:     v.x  = value; break;
+        case PlyPropertyTypes::kY:     v.y  = value; break;
+        case PlyPropertyTypes::kZ:     v.z  = value; break;
+        case PlyPropertyTypes::kNX:    v.nx = value; break;
+        case PlyPropertyTypes::kNY:    v.ny = value; break;
+        case PlyPropertyTypes::kNZ:    v.nz = value; break;
+        case PlyPropertyTypes::kR:     v.r  = bits; break;
+        case PlyPropertyTypes::kG:     v.g  = bits; break;
+        case PlyPropertyTypes::kB:     v.b  = bits; break;
+        case PlyPropertyTypes::kA:     v.a  = bits; break;
+        case PlyPropertyTypes::kFlags: v.flags = bits; break;
+        default: break;
+      }
+    }
+  }
+}
+
+/// specialised decoders indexed by normals | colors << 1 | alpha << 2 | flags << 3
+const PlyVertexDecoder kVertexDecoders[16] = {
+  decodeVertexRecords<false, false, false, false>,
+  decodeVertexRecords<true,  false, false, false>,
+  decodeVertexRecords<false, true,  false, false>,
+  decodeVertexRecords<true,  true,  false, false>,
+  decodeVertexRecords<false, false, true,  false>,
+  decodeVertexRecords<true,  false, true,  false>,
+  decodeVertexRecords<false, true,  true,  false>,
+  decodeVertexRecords<true,  true,  true,  false>,
+  decodeVertexRecords<false, false, false, true>,
+  decodeVertexRecords<true,  false, false, true>,
+  decodeVertexRecords<false, true,  false, true>,
+  decodeVertexRecords<true,  true,  false, true>,
+  decodeVertexRecords<false, false, true,  true>,
+  decodeVertexRecords<true,  false, true,  true>,
+  decodeVertexRecords<false, true,  true,  true>,
+  decodeVertexRecords<true,  true,  true,  true>,
+};
+
+/// specialised encoders, indexed like kVertexDecoders
+const PlyVertexEncoder kVertexEncoders[16] = {
+  encodeVertexRecords<false, false, false, false>,
+  encodeVertexRecords<true,  false, false, false>,
+  encodeVertexRecords<false, true,  false, false>,
+  encodeVertexRecords<true,  true,  false, false>,
+  encodeVertexRecords<false, false, true,  false>,
+  encodeVertexRecords<true,  false, true,  false>,
+  encodeVertexRecords<false, true,  true,  false>,
+  encodeVertexRecords<true,  true,  true,  false>,
+  encodeVertexRecords<false, false, false, true>,
+  encodeVertexRecords<true,  false, false, true>,
+  encodeVertexRecords<false, true,  false, true>,
+  encodeVertexRecords<true,  true,  false, true>,
+  encodeVertexRecords<false, false, true,  true>,
+  encodeVertexRecords<true,  false, true,  true>,
+  encodeVertexRecords<false, true,  true,  true>,
+  encodeVertexRecords<true,  true,  true,  true>,
+};
+
+// --- ascii parsing -------------------------------------------------------
+
+inline bool isAsciiBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+/// returns the start of the next non blank line in [p, end), nullptr if none
+inline const char* nextAsciiRecord(const char* p, const char* end) {
+  while(p < end && (isAsciiBlank(*p) || *p == '\n')) p++;
+  return p < end ? p : nullptr;
+}
+
+/// returns the position after the newline ending the line at p
+inline const char* skipAsciiLine(const char* p, const char* end) {
+  const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+  return nl ? nl + 1 : end;
+}
+
+/// exact powers of ten representable as double
+const double kPow10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/** parses a decimal number at p without consulting the locale
+ *
+ *  Stays on the current line and advances p past the number. Returns false
+ *  if no number is found.
+ */
+inline bool parseAsciiNumber(const char*& p, const char* end, double& value) {
+  while(p < end && isAsciiBlank(*p)) p++;
+
+  bool negative = false;
+  if(p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+  // nan and inf as printed by printf and ostream
+  if(p < end && (*p == 'n' || *p == 'N' || *p == 'i' || *p == 'I')) {
+    const char* word = p;
+    while(p < end && std::isalpha(static_cast<unsigned char>(*p))) p++;
+    const std::string token(word, p);
+    if(token == "nan" || token == "NaN" || token == "NAN")
+      value = std::numeric_limits<double>::quiet_NaN();
+    else if(token == "inf" || token == "Inf" || token == "INF"
+        || token == "infinity" || token == "Infinity")
+      value = std::numeric_limits<double>::infinity();
+    else
+      return false;
+    if(negative) value = -value;
+    return true;
+  }
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int numDigits = 0;
+  for(; p < end && *p >= '0' && *p <= '9'; p++, numDigits++) {
+    if(mantissa < 100000000000000000ull) mantissa = mantissa * 10 + (*p - '0');
+    else exponent++;
+  }
+  if(p < end && *p == '.') {
+    for(p++; p < end && *p >= '0' && *p <= '9'; p++, numDigits++) {
+      if(mantissa < 100000000000000000ull) {
+        mantissa = mantissa * 10 + (*p - '0');
+        exponent--;
+      }
+    }
+  }
+  if(numDigits == 0) return false;
+
+  if(p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool negativeExp = false;
+    if(p < end && (*p == '-' || *p == '+')) negativeExp = (*p++ == '-');
+    int e = 0;
+    for(; p < end && *p >= '0' && *p <= '9'; p++)
+      if(e < 10000) e = e * 10 + (*p - '0');
+    exponent += negativeExp ? -e : e;
+  }
+
+  value = static_cast<double>(mantissa);
+  if(exponent < 0)
+    value = exponent >= -22 ? value / kPow10[-exponent]
+                            : value * std::pow(10.0, exponent);
+  else if(exponent > 0)
+    value = exponent <= 22 ? value * kPow10[exponent]
+                           : value * std::pow(10.0, exponent);
+  if(negative) value = -value;
+  return true;
+}
+
+template <typename T>
+inline bool parseAscii(const char*& p, const char* end, T& out) {
+  double value;
+  if(!parseAsciiNumber(p, end, value)) return false;
+  out = static_cast<T>(value);
+  return true;
+}
+
+/// parses one ascii vertex line starting at p
+bool parseAsciiPoint(const char* p, const char* end,
+                     const PlyElement& element, Point& v) {
+  end = skipAsciiLine(p, end);
+  bool ok = true;
+  unsigned int color = 0;
+  for(const PlyProperty& prop : element.properties) {
+    switch (prop.propertyType) {
+      case PlyPropertyTypes::kX:     ok = parseAscii(p, end, v.x);  break;
+      case PlyPropertyTypes::kY:     ok = parseAscii(p, end, v.y);  break;
+      case PlyPropertyTypes::kZ:     ok = parseAscii(p, end, v.z);  break;
+      case PlyPropertyTypes::kNX:    ok = parseAscii(p, end, v.nx); break;
+      case PlyPropertyTypes::kNY:    ok = parseAscii(p, end, v.ny); break;
+      case PlyPropertyTypes::kNZ:    ok = parseAscii(p, end, v.nz); break;
+      case PlyPropertyTypes::kR:
+        ok = parseAscii(p, end, color); v.r = color; break;
+      case PlyPropertyTypes::kG:
+        ok = parseAscii(p, end, color); v.g = color; break;
+      case PlyPropertyTypes::kB:
+        ok = parseAscii(p, end, color); v.b = color; break;
+      case PlyPropertyTypes::kA:
+        ok = parseAscii(p, end, color); v.a = color; break;
+      case PlyPropertyTypes::kFlags: ok = parseAscii(p, end, v.flags); break;
+      default: ok = false;
+    }
+    if(!ok) return false;
+  }
+  return true;
+}
+
+/// parses one ascii face line starting at p
+bool parseAsciiFace(const char* p, const char* end,
+                    const PlyElement& element, Face& f) {
+  end = skipAsciiLine(p, end);
+  bool ok = true;
+  unsigned int color = 0;
+  int numList = 0;
+  for(const PlyProperty& prop : element.properties) {
+    switch (prop.propertyType) {
+      case PlyPropertyTypes::kR:
+        ok = parseAscii(p, end, color); f.r = color; break;
+      case PlyPropertyTypes::kG:
+        ok = parseAscii(p, end, color); f.g = color; break;
+      case PlyPropertyTypes::kB:
+        ok = parseAscii(p, end, color); f.b = color; break;
+      case PlyPropertyTypes::kA:
+        ok = parseAscii(p, end, color); f.a = color; break;
+      case PlyPropertyTypes::kListInd:
+        ok = parseAscii(p, end, numList) && numList >= 0;
+        f.ind.resize(ok ? numList : 0);
+        for(int i = 0; ok && i < numList; i++)
+          ok = parseAscii(p, end, f.ind[i]);
+        break;
+      case PlyPropertyTypes::kListTexCoords:
+        ok = parseAscii(p, end, numList) && numList >= 0;
+        f.texCoords.resize(ok ? numList : 0);
+        for(int i = 0; ok && i < numList; i++)
+          ok = parseAscii(p, end, f.texCoords[i]);
+        break;
+      case PlyPropertyTypes::kFlags: ok = parseAscii(p, end, f.flags); break;
+      default: ok = false;
+    }
+    if(!ok) return false;
+  }
+  return true;
+}
+
+} // namespace
+
+/// builds the decode plan for the properties of a vertex element
+PlyVertexLayout PlyVertexLayout::fromElement(const PlyElement & element) {
+  PlyVertexLayout layout;
+  bool specialisable = true;
+
+  for(const PlyProperty & prop : element.properties) {
+    const int size = TypeTable[prop.variableType].stride;
+    if(prop.isList || prop.propertyType > PlyPropertyTypes::kFlags
+        || prop.propertyType == PlyPropertyTypes::kListInd
+        || prop.propertyType == PlyPropertyTypes::kListTexCoords) {
+      // vertex records with lists have no fixed stride
+      return PlyVertexLayout();
+    }
+
+    if(layout.offsets[prop.propertyType] != -1) specialisable = false;
+    layout.offsets[prop.propertyType] = static_cast<int>(layout.stride);
+
+    // normals are the only float properties whose type isnt validated
+    if((prop.propertyType == PlyPropertyTypes::kNX
+          || prop.propertyType == PlyPropertyTypes::kNY
+          || prop.propertyType == PlyPropertyTypes::kNZ)
+        && prop.variableType != PlyTypes::FLOAT32)
+      specialisable = false;
+
+    PlyVertexLayout::Field field;
+    field.offset       = layout.stride;
+    field.size         = size;
+    field.propertyType = prop.propertyType;
+    layout.fields.push_back(field);
+    layout.stride += size;
+  }
+
+  const int* o = layout.offsets;
+  const bool hasXYZ(o[kX] != -1 && o[kY] != -1 && o[kZ] != -1);
+  const int numNormals((o[kNX] != -1) + (o[kNY] != -1) + (o[kNZ] != -1));
+  const int numColors((o[kR] != -1) + (o[kG] != -1) + (o[kB] != -1));
+  if(!hasXYZ || numNormals % 3 != 0 || numColors % 3 != 0)
+    specialisable = false;
+
+  if(specialisable) {
+    const int id((numNormals == 3)
+        | (numColors == 3) << 1
+        | (o[kA] != -1) << 2
+        | (o[kFlags] != -1) << 3);
+    layout.decode = kVertexDecoders[id];
+    layout.encode = kVertexEncoders[id];
+  } else {
+    layout.decode = decodeVertexRecordsGeneric;
+    layout.encode = encodeVertexRecordsGeneric;
+  }
+  return layout;
+}
 
 // ----------------------------------------------------------------------------
 // PlyReader
@@ -54,6 +471,7 @@ void PlyReader::readHeader() {
     else
       throwRuntimeError("Error: Cant read header");
   }
+  vertexLayout = PlyVertexLayout::fromElement(pointElement);
   // LOG << "Read PLY header ("
   //     << pointElement.count << " points, "
   //     << faceElement.count << " face )";
@@ -92,24 +510,194 @@ void PlyReader::readHeaderProperty (std::istringstream & is) {
     faceElement.properties.push_back(pp);
 }
 
+/// maps the file and, for binary files, places the cursor after end_header
+void PlyReader::mapBody(const std::string& filename) {
+#ifdef PLYIO_HAS_MMAP
+  const std::streamoff headerSize = file.tellg();
+  if(headerSize < 0) return;
+
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if(fd < 0) return;
+
+  struct stat st;
+  if(::fstat(fd, &st) != 0 || st.st_size <= headerSize) {
+    ::close(fd);
+    return;
+  }
+
+  void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+  if(data == MAP_FAILED) {
+    DEBUG << "mmap failed, falling back to stream reading";
+    return;
+  }
+  ::madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+  mappedData = static_cast<const char*>(data);
+  mappedSize = static_cast<size_t>(st.st_size);
+  cursor     = isBinary ? mappedData + headerSize : nullptr;
+  bodyEnd    = mappedData + mappedSize;
+  DEBUG << "Memory mapped " << mappedSize << " bytes";
+#endif
+}
+
+/// releases the mapping created by mapBody
+void PlyReader::unmapBody() {
+#ifdef PLYIO_HAS_MMAP
+  if(mappedData)
+    ::munmap(const_cast<char*>(mappedData), mappedSize);
+#endif
+  mappedData = cursor = bodyEnd = nullptr;
+  mappedSize = 0;
+}
+
 /// Reads all elements and stores in ram
 bool PlyReader::readFile() {
-  const size_t numPoints(pointElement.count);
-  const size_t numFaces(faceElement.count);
+  const size_t numPoints(pointElement.count - pointElement.readCount);
+  const size_t offset(points.size());
+  points.resize(offset + numPoints);
+
+  if(isBinary) {
+    // decode in batches so the stream path keeps a bounded staging buffer
+    const size_t batch(cursor ? numPoints : size_t(1) << 16);
+    for(size_t done = 0; done < numPoints; done += batch) {
+      const size_t n(std::min(batch, numPoints - done));
+      readBinaryPoints(points.data() + offset + done, n);
+      pointElement.readCount += n;
+    }
+    readFaces();
+  } else {
+    readAsciiElements(points.data() + offset);
+  }
+  // LOG << "Read " << points.size() << " points and "
+  //   << faces.size() << " faces.";
+  return true;
+}
+
+/// Reorders points along a Morton curve after readFile
+void PlyReader::sortPoints() {
+  const size_t n(points.size());
+  if(n > std::numeric_limits<uint32_t>::max())
+    throwRuntimeError("Too many points to sort");
+
+  float x0 = std::numeric_limits<float>::max();
+  float y0 = std::numeric_limits<float>::max();
+  float z0 = std::numeric_limits<float>::max();
+  float x1 = std::numeric_limits<float>::lowest();
+  float y1 = std::numeric_limits<float>::lowest();
+  float z1 = std::numeric_limits<float>::lowest();
+#ifdef USE_OpenMP
+  #pragma omp parallel for reduction(min:x0,y0,z0) reduction(max:x1,y1,z1)
+#endif
+  for(size_t i = 0; i < n; i++) {
+    const Point& p = points[i];
+    x0 = std::min(x0, p.x); y0 = std::min(y0, p.y); z0 = std::min(z0, p.z);
+    x1 = std::max(x1, p.x); y1 = std::max(y1, p.y); z1 = std::max(z1, p.z);
+  }
+  float size(std::max(x1 - x0, std::max(y1 - y0, z1 - z0)));
+  if(!(size > 0.0f)) size = 1.0f;
+  const float scale(float(kMortonAxisSize) / size);
 
-  for(size_t i =0 ; i < numPoints; i++ ) {
-    Point v;
-    readPoint(v);
-    points.push_back(v);
+  std::vector<uint64_t> keys(n);
+  permutation.resize(n);
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for(size_t i = 0; i < n; i++) {
+    const Point& p = points[i];
+    const uint64_t x(std::min<uint64_t>(kMortonAxisSize - 1,
+        static_cast<uint64_t>(std::max(0.0f, (p.x - x0) * scale))));
+    const uint64_t y(std::min<uint64_t>(kMortonAxisSize - 1,
+        static_cast<uint64_t>(std::max(0.0f, (p.y - y0) * scale))));
+    const uint64_t z(std::min<uint64_t>(kMortonAxisSize - 1,
+        static_cast<uint64_t>(std::max(0.0f, (p.z - z0) * scale))));
+    keys[i] = mortonEncode3(x, y, z);
+    permutation[i] = static_cast<uint32_t>(i);
   }
+  radixSortPairs(keys, permutation, 3 * kMortonAxisBits);
+
+  std::vector<Point> sorted(n);
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for(size_t i = 0; i < n; i++) sorted[i] = points[permutation[i]];
+  points.swap(sorted);
+
+  if(faces.empty()) return;
+  // new index of every file index
+  std::vector<uint32_t> rank(n);
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for(size_t i = 0; i < n; i++) rank[permutation[i]] = static_cast<uint32_t>(i);
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(dynamic, 4096)
+#endif
+  for(size_t f = 0; f < faces.size(); f++)
+    for(int& index : faces[f].ind)
+      if(index >= 0 && static_cast<size_t>(index) < n) index = rank[index];
+}
+
+/// Reads all points into a structure of arrays cloud and faces into faces
+bool PlyReader::readFile(PointCloud & cloud) {
+  bool normals = false, colors = false, flags = false;
+  for(const PlyProperty& prop : pointElement.properties) {
+    normals = normals || (prop.propertyType >= PlyPropertyTypes::kNX
+                          && prop.propertyType <= PlyPropertyTypes::kNZ);
+    colors  = colors  || (prop.propertyType >= PlyPropertyTypes::kR
+                          && prop.propertyType <= PlyPropertyTypes::kA);
+    flags   = flags   || prop.propertyType == PlyPropertyTypes::kFlags;
+  }
+  cloud.setAttributes(normals || cloud.hasNormals(),
+                      colors || cloud.hasColors(),
+                      flags || cloud.hasFlags());
+
+  const size_t numPoints(pointElement.count - pointElement.readCount);
+  const size_t offset(cloud.size());
+  cloud.resize(offset + numPoints);
+
+  if(!isBinary) {
+    // the ascii parser fills records in place, convert afterwards
+    Points parsed(numPoints);
+    readAsciiElements(parsed.data());
+    cloud.setPoints(offset, parsed.data(), numPoints);
+    return true;
+  }
+
+  // decode small batches that stay in cache and scatter them to the arrays
+  Points batch(std::min<size_t>(numPoints, 4096));
+  for(size_t done = 0; done < numPoints; done += batch.size()) {
+    const size_t n(std::min(batch.size(), numPoints - done));
+    readBinaryPoints(batch.data(), n);
+    cloud.setPoints(offset + done, batch.data(), n);
+    pointElement.readCount += n;
+  }
+  readFaces();
+  return true;
+}
+
+/// reads the remaining faces in the stream into faces
+void PlyReader::readFaces() {
+  const size_t numFaces(faceElement.count - faceElement.readCount);
+  faces.reserve(faces.size() + numFaces);
   for(size_t i =0 ; i < numFaces; i++ ) {
     Face f;
     readFace(f);
     faces.push_back(f);
   }
-  // LOG << "Read " << points.size() << " points and "
-  //   << faces.size() << " faces.";
-  return true;
+}
+
+/// parses the remaining ascii points into dst and faces into faces
+void PlyReader::readAsciiElements(Point* dst) {
+  const std::streamoff offset = file.tellg();
+  if(mappedData && offset >= 0) {
+    readAsciiBody(mappedData + offset, bodyEnd, dst);
+  } else {
+    const std::string body((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    readAsciiBody(body.data(), body.data() + body.size(), dst);
+  }
 }
 
 /// Reads the next point in the stream
@@ -119,6 +707,35 @@ bool PlyReader::readPoint(Point &v) {
     return false;
   }
 
+  if(isBinary) readBinaryPoints(&v, 1);
+  else readAsciiPoint(v);
+
+  pointElement.readCount++;
+  return true;
+}
+
+/// decodes the next n binary vertex records into dst
+void PlyReader::readBinaryPoints(Point* dst, const size_t n) {
+  if(!vertexLayout.decode)
+    throwRuntimeError("Not property type of vertex");
+
+  const size_t numBytes(n * vertexLayout.stride);
+  if(cursor) {
+    if(static_cast<size_t>(bodyEnd - cursor) < numBytes)
+      throwRuntimeError("Unexpected end of ply file");
+    vertexLayout.decode(cursor, n, vertexLayout, dst);
+    cursor += numBytes;
+  } else {
+    recordBuffer.resize(numBytes);
+    file.read(recordBuffer.data(), numBytes);
+    if(static_cast<size_t>(file.gcount()) != numBytes)
+      throwRuntimeError("Unexpected end of ply file");
+    vertexLayout.decode(recordBuffer.data(), n, vertexLayout, dst);
+  }
+}
+
+/// parses the next ascii vertex line into v
+void PlyReader::readAsciiPoint(Point &v) {
   for(const PlyProperty& prop : pointElement.properties) {
     const int size = TypeTable[prop.variableType].stride;
     switch (prop.propertyType) {
@@ -162,8 +779,87 @@ bool PlyReader::readPoint(Point &v) {
         throwRuntimeError("Not property type of vertex");
     }
   }
-  pointElement.readCount++;
-  return true;
+}
+
+/// parses the remaining ascii body [begin, end) into dst and faces
+void PlyReader::readAsciiBody(const char* begin, const char* end,
+                              Point* dst) {
+  const size_t numPoints(pointElement.count - pointElement.readCount);
+  const size_t numFaces(faceElement.count - faceElement.readCount);
+  const size_t numRecords(numPoints + numFaces);
+
+  // split the body into newline aligned chunks, a few per thread
+  int numThreads = 1;
+#ifdef USE_OpenMP
+  numThreads = omp_get_max_threads();
+#endif
+  const size_t minChunkSize(size_t(1) << 16);
+  const size_t bodySize(end - begin);
+  const size_t numChunks(std::max<size_t>(1,
+      std::min<size_t>(numThreads * 4, bodySize / minChunkSize)));
+
+  std::vector<const char*> chunkBegin(numChunks + 1, end);
+  chunkBegin[0] = begin;
+  for(size_t c = 1; c < numChunks; c++) {
+    const char* p = std::max(chunkBegin[c - 1], begin + c * (bodySize / numChunks));
+    p = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    chunkBegin[c] = p ? p + 1 : end;
+  }
+
+  // count records per chunk and turn the counts into first record ids
+  std::vector<size_t> chunkFirstRecord(numChunks + 1, 0);
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for(size_t c = 0; c < numChunks; c++) {
+    size_t count = 0;
+    const char* p = chunkBegin[c];
+    while((p = nextAsciiRecord(p, chunkBegin[c + 1])) != nullptr) {
+      count++;
+      p = skipAsciiLine(p, chunkBegin[c + 1]);
+    }
+    chunkFirstRecord[c + 1] = count;
+  }
+  for(size_t c = 0; c < numChunks; c++)
+    chunkFirstRecord[c + 1] += chunkFirstRecord[c];
+
+  if(chunkFirstRecord[numChunks] < numRecords)
+    throwRuntimeError("Unexpected end of ply file");
+
+  const size_t faceOffset(faces.size());
+  faces.resize(faceOffset + numFaces);
+
+  // records are parsed independently, errors are collected and thrown after
+  bool failed = false;
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for(size_t c = 0; c < numChunks; c++) {
+    size_t record(chunkFirstRecord[c]);
+    const char* p = chunkBegin[c];
+    const char* chunkEnd = chunkBegin[c + 1];
+    bool ok = true;
+    while(ok && record < numRecords
+          && (p = nextAsciiRecord(p, chunkEnd)) != nullptr) {
+      if(record < numPoints)
+        ok = parseAsciiPoint(p, chunkEnd, pointElement, dst[record]);
+      else
+        ok = parseAsciiFace(p, chunkEnd, faceElement,
+                            faces[faceOffset + record - numPoints]);
+      p = skipAsciiLine(p, chunkEnd);
+      record++;
+    }
+    if(!ok) {
+#ifdef USE_OpenMP
+      #pragma omp atomic write
+#endif
+      failed = true;
+    }
+  }
+  if(failed) throwRuntimeError("Invalid ascii element in ply file");
+
+  pointElement.readCount = pointElement.count;
+  faceElement.readCount = faceElement.count;
 }
 
 /// Reads the next face in the stream
@@ -213,12 +909,108 @@ bool PlyReader::readFace(Face &f) {
   return true;
 }
 
+// ----------------------------------------------------------------------------
+// AsyncBlockWriter
+// ----------------------------------------------------------------------------
+
+AsyncBlockWriter::AsyncBlockWriter(std::ostream& os,
+                                   const size_t maxQueuedBlocks)
+  : stream(os), maxQueued(std::max<size_t>(1, maxQueuedBlocks)),
+    busy(false), stopping(false), failed(false) {
+  worker = std::thread(&AsyncBlockWriter::run, this);
+}
+
+/// writes all queued blocks and stops the worker
+AsyncBlockWriter::~AsyncBlockWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  queueChanged.notify_all();
+  worker.join();
+}
+
+/// queues the first used bytes of block for writing
+void AsyncBlockWriter::submit(std::vector<char>& block, const size_t used) {
+  std::unique_lock<std::mutex> lock(mutex);
+  queueChanged.wait(lock, [this] { return queue.size() < maxQueued; });
+
+  Block b;
+  b.used = used;
+  b.data.swap(block);
+  queue.push_back(std::move(b));
+
+  if(!freeBlocks.empty()) {
+    block.swap(freeBlocks.back());
+    freeBlocks.pop_back();
+  }
+  queueChanged.notify_all();
+}
+
+/// waits until every queued block is written, false if a write failed
+bool AsyncBlockWriter::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  queueChanged.wait(lock, [this] { return queue.empty() && !busy; });
+  return !failed;
+}
+
+void AsyncBlockWriter::run() {
+  for(;;) {
+    Block b;
+    bool skip;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      queueChanged.wait(lock, [this] { return stopping || !queue.empty(); });
+      if(queue.empty()) return;
+      b = std::move(queue.front());
+      queue.pop_front();
+      busy = true;
+      skip = failed;
+    }
+    queueChanged.notify_all();
+
+    // once a write failed the remaining blocks are dropped
+    if(!skip) stream.write(b.data.data(), b.used);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      failed = failed || stream.fail();
+      busy = false;
+      freeBlocks.push_back(std::move(b.data));
+    }
+    queueChanged.notify_all();
+  }
+}
+
 // ----------------------------------------------------------------------------
 // PlyWriter
 // ----------------------------------------------------------------------------
 
+const size_t PlyWriter::kBufferSize;
+
+/// Writes full staging buffers on a background thread from now on
+void PlyWriter::enableAsync(const size_t maxQueuedBuffers) {
+  if(!isBinary)
+    throwRuntimeError("Asynchronous writing requires the binary format");
+  if(asyncWriter) return;
+  flushBuffer();
+  asyncWriter.reset(new AsyncBlockWriter(file, maxQueuedBuffers));
+}
+
+/// Writes all buffered records, throws if writing failed
+void PlyWriter::flush() {
+  flushBuffer();
+  bool failed(asyncWriter && !asyncWriter->wait());
+  file.flush();
+  failed = failed || file.fail();
+  if(failed) throwRuntimeError("Failed writing ply file");
+}
+
 /// Writes the PLY header to file
 void PlyWriter::writeHeader() {
+  // the header goes straight to the stream, the worker has to be idle
+  if(asyncWriter) flush();
+
   file  << "ply" << std::endl
         << (isBinary? "format binary_little_endian 1.0" :
             "format ascii 1.0") << std::endl
@@ -228,7 +1020,13 @@ void PlyWriter::writeHeader() {
   if (faceCount == 0) faceCount = faces.size();
 
   if(pointElement.properties.size() > 0){
-    file << "element vertex " << pointsCount << std::endl;
+    file << "element vertex ";
+    if(countDigits > 0)
+      file << std::setfill('0') << std::setw(countDigits) << pointsCount
+           << std::setfill(' ');
+    else
+      file << pointsCount;
+    file << std::endl;
     for(const auto & prop : pointElement.properties) {
       file << "property ";
       if (prop.isList) {
@@ -254,14 +1052,80 @@ void PlyWriter::writeHeader() {
   file << "end_header" << std::endl;
 }
 
+/// Rewrites the vertex count in the header of a file written with
+/// reserveCountDigits
+void PlyWriter::updatePointsCount(const std::string& filename,
+                                  const size_t count) {
+  std::fstream f(filename, std::fstream::in | std::fstream::out
+                 | std::fstream::binary);
+  if(!f.is_open()) throwRuntimeError("Cant open file to update");
+
+  const std::string key("element vertex ");
+  std::string line;
+  std::streampos lineStart(f.tellg());
+  while(std::getline(f, line) && line.compare(0, 10, "end_header") != 0) {
+    if(line.compare(0, key.size(), key) == 0) {
+      size_t digits(line.size() - key.size());
+      if(digits > 0 && line[line.size() - 1] == '\r') digits--;
+      const std::string value(std::to_string(count));
+      if(value.size() > digits)
+        throwRuntimeError("No room for the vertex count in " + filename);
+      f.clear();
+      f.seekp(lineStart + std::streamoff(key.size()));
+      f << std::string(digits - value.size(), '0') << value;
+      if(!f) throwRuntimeError("Failed updating ply file");
+      return;
+    }
+    lineStart = f.tellg();
+  }
+  throwRuntimeError("No vertex element in " + filename);
+}
+
 /// Writes the points to file stream
 void PlyWriter::writePoints(const std::vector<Point> & points_) {
-  for(const auto & v : points_) {
-    writePoint(v);
+  writePoints(points_.data(), points_.size());
+}
+
+/// Writes the points of a structure of arrays cloud to file stream
+void PlyWriter::writePoints(const PointCloud & cloud) {
+  // gather small batches that stay in cache and encode them
+  Points batch(std::min<size_t>(cloud.size(), 4096));
+  for(size_t i = 0; i < cloud.size(); i += batch.size()) {
+    const size_t n(std::min(batch.size(), cloud.size() - i));
+    cloud.getPoints(i, n, batch.data());
+    writePoints(batch.data(), n);
+  }
+}
+
+/// Writes numPoints points starting at src to file stream
+void PlyWriter::writePoints(const Point* src, const size_t numPoints) {
+  if(!isBinary) {
+    for(size_t i = 0; i < numPoints; i++) {
+      writePoint(src[i]);
+    }
+    return;
+  }
+  if(!vertexLayout.encode)
+    throwRuntimeError("Invalid property type");
+
+  // encode whole batches of records straight into the staging buffer
+  const size_t stride(vertexLayout.stride);
+  const size_t batch(std::max<size_t>(1, kBufferSize / stride));
+  for(size_t i = 0; i < numPoints; i += batch) {
+    const size_t n(std::min(batch, numPoints - i));
+    vertexLayout.encode(src + i, n, vertexLayout, reserveBuffer(n * stride));
   }
 }
 
 void PlyWriter::writePoint(const Point & v) {
+  if(isBinary) {
+    if(!vertexLayout.encode)
+      throwRuntimeError("Invalid property type");
+    vertexLayout.encode(&v, 1, vertexLayout,
+                        reserveBuffer(vertexLayout.stride));
+    return;
+  }
+
   for(const auto & prop : pointElement.properties) {
     const int size = TypeTable[prop.variableType].stride;
     switch (prop.propertyType) {
@@ -302,17 +1166,30 @@ void PlyWriter::writePoint(const Point & v) {
         throwRuntimeError("Invalid property type");
     }
   }
-  if(!isBinary) file << std::endl;
+  file << std::endl;
 }
 /// Writes the faces to file stream
 void PlyWriter::writeFaces() {
+  // resolve property sizes once instead of per face
+  struct FaceField {
+    PlyPropertyTypes  propertyType;
+    int               size;
+    int               listVarSize;
+  };
+  std::vector<FaceField> fields;
+  for(const auto & prop : faceElement.properties) {
+    FaceField field;
+    field.propertyType = prop.propertyType;
+    field.size         = TypeTable[prop.variableType].stride;
+    field.listVarSize  = prop.isList ? TypeTable[prop.listSizeType].stride : 0;
+    fields.push_back(field);
+  }
+
   for(const auto & f : faces) {
-    for(const auto & prop : faceElement.properties) {
-      const int size = TypeTable[prop.variableType].stride;
-      int listVarSize = 0;
-      if(prop.isList)
-        listVarSize = TypeTable[prop.listSizeType].stride;
-      switch (prop.propertyType) {
+    for(const auto & field : fields) {
+      const int size = field.size;
+      const int listVarSize = field.listVarSize;
+      switch (field.propertyType) {
         case PlyPropertyTypes::kR:
           writeProperty<uint8_t>(f.r, size);
           break;
@@ -331,9 +1208,9 @@ void PlyWriter::writeFaces() {
             writeProperty<int>(i, size);
           break;
         case PlyPropertyTypes::kListTexCoords:
-          writeProperty<uint8_t>(f.ind.size(), listVarSize);
-          for(const auto & i : f.ind)
-            writeProperty<float>(i, size);
+          writeProperty<uint8_t>(f.texCoords.size(), listVarSize);
+          for(const auto & t : f.texCoords)
+            writeProperty<float>(t, size);
           break;
         case PlyPropertyTypes::kFlags:
           writeProperty<int>(f.flags, size);
@@ -422,6 +1299,7 @@ void PlyWriter::addVertexElement ( bool _3DPoints, bool normals,
     propertyFlags.isList       = false;
     pointElement.properties.push_back(propertyFlags);
   }
+  vertexLayout = PlyVertexLayout::fromElement(pointElement);
 }
 
 /// Adds properties for Face element
@@ -430,16 +1308,18 @@ void PlyWriter:: addFaceElement ( bool listVertIndices,
   if(listVertIndices) {
     PlyProperty propertyInd;
     propertyInd.propertyType = PlyPropertyTypes::kListInd;
-    propertyInd.variableType = PlyTypes::FLOAT32;
+    propertyInd.variableType = PlyTypes::INT32;
     propertyInd.isList       = true;
+    propertyInd.listSizeType = PlyTypes::UINT8;
     faceElement.properties.push_back(propertyInd);
   }
 
   if(texCoords) {
     PlyProperty property;
     property.propertyType = PlyPropertyTypes::kListTexCoords;
-    property.variableType = PlyTypes::UINT8;
+    property.variableType = PlyTypes::FLOAT32;
     property.isList       = true;
+    property.listSizeType = PlyTypes::UINT8;
     faceElement.properties.push_back(property);
   }
 
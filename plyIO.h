@@ -3,14 +3,22 @@
 
 //STL
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include <vector>
 #include <map>
 #include <sstream>
 #include <fstream>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 // pcLib
 #include <common.h>
 #include <types.h>
+#include <pointCloud.h>
 
 
 /*! brief Possible Ply Formats
@@ -227,6 +235,48 @@ struct PlyElement {
 };
 
 
+struct PlyVertexLayout;
+
+/// Decodes count consecutive binary vertex records from src into dst
+typedef void (*PlyVertexDecoder)(const char* src, size_t count,
+                                 const PlyVertexLayout& layout, Point* dst);
+
+/// Encodes count points from src into consecutive binary records at dst
+typedef void (*PlyVertexEncoder)(const Point* src, size_t count,
+                                 const PlyVertexLayout& layout, char* dst);
+
+/** \struct PlyVertexLayout
+  * \brief Decode and encode plan for binary vertex records.
+  *
+  * Computed once from the header. Holds the record stride and the byte
+  * offset of every property, and selects a decoder and encoder specialised
+  * for the properties present so that no per property dispatch happens per
+  * point.
+  */
+struct PlyVertexLayout {
+  /// one decoded field, used by the generic decoder
+  struct Field {
+    size_t            offset;
+    int               size;
+    PlyPropertyTypes  propertyType;
+  };
+
+  size_t              stride; ///< bytes per vertex record
+  /// byte offset of each property type in the record, -1 if absent
+  int                 offsets[PlyPropertyTypes::kFlags + 1];
+  std::vector<Field>  fields;
+  PlyVertexDecoder    decode; ///< nullptr if records cant be decoded
+  PlyVertexEncoder    encode; ///< nullptr if records cant be encoded
+
+  PlyVertexLayout() : stride(0), decode(nullptr), encode(nullptr) {
+    for(int & o : offsets) o = -1;
+  }
+
+  /// builds the decode plan for the properties of a vertex element
+  static PlyVertexLayout fromElement(const PlyElement & element);
+};
+
+
 /** \class PlyReader
   * \brief Enables the user to read Ply files to extract points and meshes
   *        from it.
@@ -241,28 +291,51 @@ class PlyReader {
     bool                      isBinary; ///< reference for file type
     PlyElementTypes           curElement;
 
+    /// memory mapped file contents
+    const char*               mappedData;
+    size_t                    mappedSize;
+    /// next unread byte of a mapped binary body and end of the mapping
+    const char*               cursor;
+    const char*               bodyEnd;
+
     /// stores information about the vertex element that stores points.
     PlyElement                pointElement;
     /// stores information about the face element.
     PlyElement                faceElement;
+    /// decode plan for binary vertex records
+    PlyVertexLayout           vertexLayout;
+    /// staging buffer for decoding records read from the stream
+    std::vector<char>         recordBuffer;
   public:
     // for non streaming
     std::vector<Point>        points; ///< vector accesible by user
     std::vector<Face>         faces; ///< vector accesible by user
+    /// index in the file of every point after sortPoints
+    std::vector<uint32_t>     permutation;
 
     /** constructs class object
      *  requires valid ply file name else throws runtime exception
+     *
+     *  The file is memory mapped when useMemoryMap is set and the platform
+     *  supports it. Binary elements are then decoded straight from the
+     *  mapped bytes instead of through the stream, and readFile parses
+     *  ascii bodies from the mapping in parallel.
      */
-    PlyReader (const std::string& filename) {
+    PlyReader (const std::string& filename, bool useMemoryMap = true)
+      : mappedData(nullptr), mappedSize(0), cursor(nullptr), bodyEnd(nullptr) {
       file.open(filename, std::ifstream::in | std::ifstream::binary);
 
       if(!file.is_open())
         throwRuntimeError("Cant read ply file");
 
       readHeader();
+
+      if(useMemoryMap)
+        mapBody(filename);
     }
 
     ~PlyReader () {
+      unmapBody();
       points.clear();
       faces.clear();
     }
@@ -274,6 +347,23 @@ class PlyReader {
      */
     bool readFile();
 
+    /** brief Reads all points into a structure of arrays cloud
+     *
+     *  Attributes present in the file are enabled on the cloud, faces are
+     *  read to faces.
+     */
+    bool readFile(PointCloud & cloud);
+
+    /** brief Reorders points along a Morton curve after readFile
+     *
+     *  Points close in space end up close in memory, which keeps neighbor
+     *  queries and voxel binning in cache. The Morton codes of a 2^21 grid
+     *  over the bounding cube are sorted with the parallel radix sort,
+     *  face indices are remapped to the new order and permutation[i] is
+     *  the index in the file of points[i].
+     */
+    void sortPoints();
+
 
     /*! brief Read one point at a time
      *
@@ -282,6 +372,13 @@ class PlyReader {
     bool readPoint(Point &v);
 
     inline size_t getPointsCount() const { return pointElement.count; }
+    inline bool isMemoryMapped() const { return mappedData != nullptr; }
+    /// true if the vertex element has the property
+    inline bool hasProperty(const PlyPropertyTypes t) const {
+      for(const PlyProperty& prop : pointElement.properties)
+        if(prop.propertyType == t) return true;
+      return false;
+    }
     inline bool pointsEmpty() const {
       return pointElement.readCount < pointElement.count;
     }
@@ -290,6 +387,21 @@ class PlyReader {
     /// reads next face in stream
     bool readFace(Face &f);
 
+    /// decodes the next n binary vertex records into dst
+    void readBinaryPoints(Point* dst, const size_t n);
+
+    /// parses the next ascii vertex line into v
+    void readAsciiPoint(Point &v);
+
+    /// reads the remaining faces in the stream into faces
+    void readFaces();
+
+    /// parses the remaining ascii points into dst and faces into faces
+    void readAsciiElements(Point* dst);
+
+    /// parses the remaining ascii body [begin, end) into dst and faces
+    void readAsciiBody(const char* begin, const char* end, Point* dst);
+
     /// Reads PLY header to find the how to read the file
     void readHeader();
 
@@ -302,6 +414,12 @@ class PlyReader {
     /// readHeaderProperty - reads the next property from stream
     void readHeaderProperty(std::istringstream & is);
 
+    /// maps the file and places the cursor after end_header
+    void mapBody(const std::string& filename);
+
+    /// releases the mapping created by mapBody
+    void unmapBody();
+
 
     template <typename T>
       inline T readProperty(const int& size) {
@@ -320,16 +438,69 @@ class PlyReader {
 
     template <typename T>
       inline T readBinary (const int& size) {
-        T data;
-        file.read(reinterpret_cast<char*>(&data), size);
+        T data = T();
+        if(cursor) {
+          if(bodyEnd - cursor < size)
+            throwRuntimeError("Unexpected end of ply file");
+          std::memcpy(&data, cursor, size);
+          cursor += size;
+        } else
+          file.read(reinterpret_cast<char*>(&data), size);
         return data;
       }
 }; // class PlyReader
 
+/** \class AsyncBlockWriter
+  * \brief Writes blocks of bytes to a stream on a background thread.
+  *
+  * Filled blocks are queued and written in order by a worker thread while
+  * the caller fills the next one. The queue is bounded, so submit blocks
+  * the caller when the disk cant keep up. Written blocks are recycled.
+  */
+class AsyncBlockWriter {
+  private:
+    struct Block {
+      std::vector<char>             data;
+      size_t                        used;
+    };
+
+    std::ostream&                   stream;
+    const size_t                    maxQueued;
+    std::deque<Block>               queue; ///< filled blocks in write order
+    std::vector<std::vector<char> > freeBlocks; ///< written blocks for reuse
+    std::mutex                      mutex;
+    std::condition_variable         queueChanged;
+    bool                            busy; ///< worker is writing a block
+    bool                            stopping;
+    bool                            failed;
+    std::thread                     worker;
+
+  public:
+    AsyncBlockWriter(std::ostream& os, const size_t maxQueuedBlocks);
+
+    /// writes all queued blocks and stops the worker
+    ~AsyncBlockWriter();
+
+    /** queues the first used bytes of block for writing
+     *
+     *  block is replaced by a recycled (or empty) block to fill next
+     */
+    void submit(std::vector<char>& block, const size_t used);
+
+    /// waits until every queued block is written, false if a write failed
+    bool wait();
+
+  private:
+    void run();
+}; // class AsyncBlockWriter
+
 /** \class PlyWriter
   * \brief Enables the user to export point clouds and meshes as Ply files.
   *
   * Supports Ascii and little endian binary formats of PLY.
+  * Binary records are packed into a staging buffer and written to the file
+  * in large blocks. With enableAsync the blocks are written by a background
+  * thread while the caller keeps filling the next one.
   */
 class PlyWriter {
   private:
@@ -340,24 +511,46 @@ class PlyWriter {
     PlyElement              pointElement;
     /// stores information about the face element.
     PlyElement              faceElement;
+    /// encode plan for binary vertex records
+    PlyVertexLayout         vertexLayout;
 
     size_t                  pointsCount;
     size_t                  faceCount;
+    /// width the vertex count is zero padded to in the header, 0 for none
+    int                     countDigits;
+
+    /// staging buffer for binary records, flushed when full
+    std::vector<char>       buffer;
+    size_t                  bufferUsed;
+    /// writes full staging buffers in the background, if enabled
+    std::unique_ptr<AsyncBlockWriter> asyncWriter;
+
+    /// size of the staging buffer in bytes
+    static const size_t     kBufferSize = size_t(1) << 22;
 
   public:
     std::vector<Point>        points; ///< vector accesible by user
     std::vector<Face>         faces; ///< vector accesible by user
 
-    /// constructs class object requires valid filename
-    PlyWriter (const std::string& filename, bool binary = true)
-      : isBinary(binary), pointsCount(0), faceCount(0) {
-      file.open(filename, std::ofstream::out | std::ofstream::binary);
+    /** constructs class object requires valid filename
+     *
+     *  With append the records are added to the end of an existing file,
+     *  whose header was written before, writeHeader mustnt be called.
+     */
+    PlyWriter (const std::string& filename, bool binary = true,
+               bool append = false)
+      : isBinary(binary), pointsCount(0), faceCount(0), countDigits(0),
+        bufferUsed(0) {
+      file.open(filename, std::ofstream::out | std::ofstream::binary
+                | (append ? std::ofstream::app : std::ofstream::trunc));
 
       if(!file.is_open())
         throwRuntimeError("Cant open file to write");
     }
 
     ~PlyWriter() {
+      if(file.is_open()) flushBuffer();
+      asyncWriter.reset();
       points.clear();
       faces.clear();
     }
@@ -375,18 +568,51 @@ class PlyWriter {
       writeHeader();
       writePoints(points);
       writeFaces();
-      file.close();
+      closeFile();
       // LOG << points.size() << " points and "
       //    << faces.size() << " faces written to PLY file.";
     }
 
-    void closeFile() {file.close(); }
+    /** Writes full staging buffers on a background thread from now on
+     *
+     *  At most maxQueuedBuffers filled buffers wait for the disk, further
+     *  writes block until one is written. Requires the binary format.
+     */
+    void enableAsync(const size_t maxQueuedBuffers = 2);
+
+    /// Writes all buffered records, throws if writing failed
+    void flush();
+
+    /// Flushes buffered records and closes the file, throws if writing failed
+    void closeFile() {
+      flushBuffer();
+      bool failed(asyncWriter && !asyncWriter->wait());
+      asyncWriter.reset();
+      failed = failed || file.fail();
+      file.close();
+      if(failed) throwRuntimeError("Failed writing ply file");
+    }
 
     void setPointsCount(const size_t pc) { pointsCount = pc; }
 
+    /// Zero pads the vertex count in the header to digits, so it can be
+    /// rewritten by updatePointsCount once the final count is known
+    void reserveCountDigits(const int digits) { countDigits = digits; }
+
+    /// Rewrites the vertex count in the header of a file written with
+    /// reserveCountDigits, throws if count needs more digits
+    static void updatePointsCount(const std::string& filename,
+                                  const size_t count);
+
     /// Writes the points to file stream
     void writePoints(const std::vector<Point> & points);
 
+    /// Writes the points of a structure of arrays cloud to file stream
+    void writePoints(const PointCloud & cloud);
+
+    /// Writes numPoints points starting at src to file stream
+    void writePoints(const Point* src, const size_t numPoints);
+
     /// Writes the PLY header to file
     void writeHeader();
    /// Write a single point to file stream
@@ -394,6 +620,25 @@ class PlyWriter {
     /// Writes the faces to file stream
     void writeFaces();
   private:
+    /// writes the staged binary records to the file or the async queue
+    void flushBuffer() {
+      if(bufferUsed == 0) return;
+      if(asyncWriter) asyncWriter->submit(buffer, bufferUsed);
+      else file.write(buffer.data(), bufferUsed);
+      bufferUsed = 0;
+    }
+
+    /// returns space for numBytes in the staging buffer, flushing if needed
+    inline char* reserveBuffer(const size_t numBytes) {
+      if(bufferUsed + numBytes > buffer.size()) {
+        flushBuffer();
+        if(numBytes > buffer.size())
+          buffer.resize(std::max(kBufferSize, numBytes));
+      }
+      char* dst = &buffer[bufferUsed];
+      bufferUsed += numBytes;
+      return dst;
+    }
 
     template <typename T>
       inline void writeProperty(T x, const int& size) {
@@ -410,7 +655,7 @@ class PlyWriter {
 
     template <typename T>
       inline void writeBinary (T x,const int& size) {
-        file.write(reinterpret_cast<char*>(&x), size);
+        std::memcpy(reserveBuffer(size), &x, size);
       }
 
 }; // class PlyWriter
@@ -0,0 +1,103 @@
+#include <plyTiler.h>
+#include <file_system.hpp>
+
+namespace {
+
+/// points buffered per tile before they are appended to its file
+const size_t kTileBufferPoints = size_t(1) << 14;
+
+/// digits reserved for the vertex count in the tile headers
+const int kCountDigits = 20;
+
+} // namespace
+
+PlyTiler::PlyTiler(const float & _tileSize, const std::string & _outputFolder,
+                   const size_t & _maxOpenFiles,
+                   const size_t & _maxBufferedPoints)
+  : tileSize(_tileSize), outputFolder(_outputFolder),
+    maxOpenFiles(_maxOpenFiles), maxBufferedPoints(_maxBufferedPoints),
+    numBuffered(0), normals(false), colors(false), flags(false) {
+  if(tileSize <= 0.0f) throwRuntimeError("Tile size cannot be <= 0.0f");
+  if(maxOpenFiles == 0) throwRuntimeError("Need at least one open file");
+  origin[0] = origin[1] = 0.0f;
+}
+
+/// Writes the tiles of inputFile to outputFolder as tile_<x>_<y>.ply
+size_t PlyTiler::tile(const std::string& inputFile) {
+  if(!stlplus::folder_exists(outputFolder)
+      && !stlplus::folder_create(outputFolder))
+    throwRuntimeError("Cant create output folder " + outputFolder);
+
+  PlyReader reader(inputFile);
+  normals = reader.hasProperty(PlyPropertyTypes::kNX);
+  colors  = reader.hasProperty(PlyPropertyTypes::kR);
+  flags   = reader.hasProperty(PlyPropertyTypes::kFlags);
+  tiles.clear();
+  openTiles.clear();
+  numBuffered = 0;
+
+  // consecutive points mostly fall into the same tile
+  TileKey lastKey;
+  Tile* last = nullptr;
+  Point p;
+  while(reader.readPoint(p)) {
+    const TileKey key(tileOf(p));
+    if(!last || key != lastKey) {
+      last = &tiles[key];
+      lastKey = key;
+    }
+    last->buffer.push_back(p);
+    last->count++;
+    numBuffered++;
+    if(last->buffer.size() >= kTileBufferPoints) flushTile(key, *last);
+    if(numBuffered >= maxBufferedPoints) {
+      for(auto& t : tiles)
+        if(!t.second.buffer.empty()) flushTile(t.first, t.second);
+    }
+  }
+
+  for(auto& t : tiles) {
+    if(!t.second.buffer.empty()) flushTile(t.first, t.second);
+    if(t.second.writer) closeTile(t.second);
+  }
+  for(const auto& t : tiles)
+    PlyWriter::updatePointsCount(t.second.file, t.second.count);
+
+  LOG << "Wrote " << tiles.size() << " tiles to " << outputFolder;
+  return tiles.size();
+}
+
+/// appends the buffer of tile to its file and clears it
+void PlyTiler::flushTile(const TileKey& key, Tile& tile) {
+  if(!tile.writer) {
+    if(openTiles.size() >= maxOpenFiles) closeTile(tiles[openTiles.back()]);
+    if(tile.file.empty()) {
+      tile.file = stlplus::create_filespec(outputFolder,
+          "tile_" + std::to_string(key.first) + "_"
+          + std::to_string(key.second) + ".ply");
+    }
+    tile.writer.reset(new PlyWriter(tile.file, true, tile.created));
+    tile.writer->addVertexElement(true, normals, colors, flags);
+    if(!tile.created) {
+      tile.writer->reserveCountDigits(kCountDigits);
+      tile.writer->writeHeader();
+      tile.created = true;
+    }
+    openTiles.push_front(key);
+    tile.lru = openTiles.begin();
+  } else {
+    openTiles.splice(openTiles.begin(), openTiles, tile.lru);
+  }
+
+  tile.writer->writePoints(tile.buffer.data(), tile.buffer.size());
+  numBuffered -= tile.buffer.size();
+  // release the memory, most tiles wont be written again soon
+  Points().swap(tile.buffer);
+}
+
+/// closes the writer of tile
+void PlyTiler::closeTile(Tile& tile) {
+  tile.writer->closeFile();
+  tile.writer.reset();
+  openTiles.erase(tile.lru);
+}
@@ -0,0 +1,86 @@
+#ifndef _PLY_TILER_H_
+#define _PLY_TILER_H_
+
+// STL
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 3DL headers
+#include <common.h>
+#include <plyIO.h>
+
+/** \class PlyTiler
+  * \brief Splits a PLY file into square XY tiles in bounded memory.
+  *
+  * Streams the input through PlyReader::readPoint and routes every point
+  * to the buffer of its tile. Full buffers are appended to the tile's file
+  * through a PlyWriter. At most maxOpenFiles writers are open at once, the
+  * least recently used one is closed when another tile needs a writer and
+  * reopened in append mode later. When all buffers together exceed
+  * maxBufferedPoints every buffer is flushed. The header of a tile is
+  * written with a zero padded vertex count when the tile is created and
+  * patched with the final count at the end, so memory stays bounded by
+  * the buffers and the open writers, whatever the input size.
+  */
+class PlyTiler {
+  protected:
+    const float               tileSize;
+    const std::string         outputFolder;
+    const size_t              maxOpenFiles;
+    const size_t              maxBufferedPoints;
+    float                     origin[2]; ///< corner of tile (0, 0)
+
+    /// tile (x, y) index
+    typedef std::pair<int64_t, int64_t> TileKey;
+
+    struct Tile {
+      std::string             file;
+      Points                  buffer;
+      size_t                  count = 0; ///< points written or buffered
+      bool                    created = false; ///< header written
+      std::unique_ptr<PlyWriter> writer; ///< null while closed
+      std::list<TileKey>::iterator lru; ///< position among open writers
+    };
+
+    std::map<TileKey, Tile>   tiles;
+    std::list<TileKey>        openTiles; ///< most recently used first
+    size_t                    numBuffered;
+    // vertex properties of the input
+    bool                      normals, colors, flags;
+
+  public:
+    PlyTiler(const float & _tileSize, const std::string & _outputFolder,
+             const size_t & _maxOpenFiles = 64,
+             const size_t & _maxBufferedPoints = size_t(1) << 24);
+
+    /// Aligns the tile borders to (x, y) instead of (0, 0)
+    void setOrigin(const float x, const float y) {
+      origin[0] = x; origin[1] = y;
+    }
+
+    /// Writes the tiles of inputFile to outputFolder as tile_<x>_<y>.ply,
+    /// returns the number of tiles
+    size_t tile(const std::string& inputFile);
+
+  protected:
+    inline TileKey tileOf(const Point& p) const {
+      return TileKey(static_cast<int64_t>(std::floor((p.x - origin[0])
+                                                     / tileSize)),
+                     static_cast<int64_t>(std::floor((p.y - origin[1])
+                                                     / tileSize)));
+    }
+
+    /// appends the buffer of tile to its file and clears it
+    void flushTile(const TileKey& key, Tile& tile);
+
+    /// closes the writer of tile
+    void closeTile(Tile& tile);
+}; // class PlyTiler
+
+#endif // _PLY_TILER_H_
@@ -0,0 +1,174 @@
+#include <pointCloud.h>
+
+// coordinate views on Points rely on x, y, z being consecutive floats
+static_assert(offsetof(Point, y) == offsetof(Point, x) + sizeof(float) &&
+              offsetof(Point, z) == offsetof(Point, y) + sizeof(float) &&
+              sizeof(Point) % sizeof(float) == 0,
+              "Unexpected Point layout");
+
+// ----------------------------------------------------------------------------
+// PointCloud
+// ----------------------------------------------------------------------------
+
+/// Converts an array of points, copying only the requested attributes
+PointCloud PointCloud::fromPoints(const Points& points, bool normals,
+                                  bool colors, bool _flags) {
+  PointCloud cloud(normals, colors, _flags);
+  cloud.resize(points.size());
+  if(!points.empty())
+    cloud.setPoints(0, points.data(), points.size());
+  return cloud;
+}
+
+/// Converts back to an array of points, absent attributes are zero
+void PointCloud::toPoints(Points& points) const {
+  points.resize(size());
+  if(!points.empty())
+    getPoints(0, size(), points.data());
+}
+
+/// Adds or drops the optional attributes
+void PointCloud::setAttributes(bool normals, bool colors, bool _flags) {
+  const size_t n(size());
+  withNormals = normals;
+  withColors  = colors;
+  withFlags   = _flags;
+  if(!withNormals) {
+    AlignedVector<float>().swap(nx);
+    AlignedVector<float>().swap(ny);
+    AlignedVector<float>().swap(nz);
+  }
+  if(!withColors) {
+    AlignedVector<uint8_t>().swap(r);
+    AlignedVector<uint8_t>().swap(g);
+    AlignedVector<uint8_t>().swap(b);
+    AlignedVector<uint8_t>().swap(a);
+  }
+  if(!withFlags) AlignedVector<int>().swap(flags);
+  resize(n);
+}
+
+void PointCloud::resize(const size_t n) {
+  x.resize(n);
+  y.resize(n);
+  z.resize(n);
+  if(withNormals) {
+    nx.resize(n);
+    ny.resize(n);
+    nz.resize(n);
+  }
+  if(withColors) {
+    r.resize(n);
+    g.resize(n);
+    b.resize(n);
+    a.resize(n);
+  }
+  if(withFlags) flags.resize(n);
+}
+
+void PointCloud::reserve(const size_t n) {
+  x.reserve(n);
+  y.reserve(n);
+  z.reserve(n);
+  if(withNormals) {
+    nx.reserve(n);
+    ny.reserve(n);
+    nz.reserve(n);
+  }
+  if(withColors) {
+    r.reserve(n);
+    g.reserve(n);
+    b.reserve(n);
+    a.reserve(n);
+  }
+  if(withFlags) flags.reserve(n);
+}
+
+/// Appends a point, attributes the cloud doesnt carry are dropped
+void PointCloud::push_back(const Point& p) {
+  x.push_back(p.x);
+  y.push_back(p.y);
+  z.push_back(p.z);
+  if(withNormals) {
+    nx.push_back(p.nx);
+    ny.push_back(p.ny);
+    nz.push_back(p.nz);
+  }
+  if(withColors) {
+    r.push_back(p.r);
+    g.push_back(p.g);
+    b.push_back(p.b);
+    a.push_back(p.a);
+  }
+  if(withFlags) flags.push_back(p.flags);
+}
+
+/// Writes n points to the positions starting at offset
+void PointCloud::setPoints(const size_t offset, const Point* src,
+                           const size_t n) {
+  // one pass per attribute group keeps the writes sequential
+  for(size_t i = 0; i < n; i++) {
+    x[offset + i] = src[i].x;
+    y[offset + i] = src[i].y;
+    z[offset + i] = src[i].z;
+  }
+  if(withNormals) {
+    for(size_t i = 0; i < n; i++) {
+      nx[offset + i] = src[i].nx;
+      ny[offset + i] = src[i].ny;
+      nz[offset + i] = src[i].nz;
+    }
+  }
+  if(withColors) {
+    for(size_t i = 0; i < n; i++) {
+      r[offset + i] = src[i].r;
+      g[offset + i] = src[i].g;
+      b[offset + i] = src[i].b;
+      a[offset + i] = src[i].a;
+    }
+  }
+  if(withFlags) {
+    for(size_t i = 0; i < n; i++)
+      flags[offset + i] = src[i].flags;
+  }
+}
+
+/// Reads n points starting at offset, absent attributes are zero
+void PointCloud::getPoints(const size_t offset, const size_t n,
+                           Point* dst) const {
+  for(size_t i = 0; i < n; i++) {
+    Point & p = dst[i];
+    const size_t j(offset + i);
+    p = Point();
+    p.x = x[j];
+    p.y = y[j];
+    p.z = z[j];
+    if(withNormals) {
+      p.nx = nx[j];
+      p.ny = ny[j];
+      p.nz = nz[j];
+    }
+    if(withColors) {
+      p.r = r[j];
+      p.g = g[j];
+      p.b = b[j];
+      p.a = a[j];
+    }
+    if(withFlags) p.flags = flags[j];
+  }
+}
+
+// ----------------------------------------------------------------------------
+// XYZView
+// ----------------------------------------------------------------------------
+
+XYZView::XYZView(const Points& points)
+  : x(points.empty() ? nullptr : &points[0].x),
+    y(points.empty() ? nullptr : &points[0].y),
+    z(points.empty() ? nullptr : &points[0].z),
+    stride(sizeof(Point) / sizeof(float)),
+    count(points.size()) {}
+
+XYZView::XYZView(const PointCloud& cloud)
+  : x(cloud.x.data()), y(cloud.y.data()), z(cloud.z.data()),
+    stride(1), count(cloud.size()) {}
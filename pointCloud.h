@@ -0,0 +1,141 @@
+#ifndef _POINT_CLOUD_H_
+#define _POINT_CLOUD_H_
+
+// STL
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// 3DL headers
+#include <common.h>
+#include <types.h>
+
+/*! \brief Allocator returning memory aligned to Alignment bytes
+ *
+ *  Used for the attribute arrays of PointCloud so that every array starts
+ *  on a cache line and can be processed with aligned vector loads.
+ */
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+  typedef T value_type;
+
+  template <typename U>
+  struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+  AlignedAllocator() {}
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  T* allocate(size_t n) {
+    // over allocate and keep the original pointer just before the block
+    void* raw = std::malloc(n * sizeof(T) + Alignment + sizeof(void*));
+    if(!raw) throw std::bad_alloc();
+    const uintptr_t start = reinterpret_cast<uintptr_t>(raw) + sizeof(void*);
+    void* aligned = reinterpret_cast<void*>(
+        (start + Alignment - 1) & ~static_cast<uintptr_t>(Alignment - 1));
+    static_cast<void**>(aligned)[-1] = raw;
+    return static_cast<T*>(aligned);
+  }
+
+  void deallocate(T* p, size_t) {
+    if(p) std::free(reinterpret_cast<void**>(p)[-1]);
+  }
+};
+
+template <typename T, typename U, size_t A>
+inline bool operator==(const AlignedAllocator<T, A>&,
+                       const AlignedAllocator<U, A>&) { return true; }
+template <typename T, typename U, size_t A>
+inline bool operator!=(const AlignedAllocator<T, A>&,
+                       const AlignedAllocator<U, A>&) { return false; }
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T> >;
+
+
+/** \class PointCloud
+  * \brief Structure of arrays point cloud.
+  *
+  * Every attribute is stored in its own contiguous, cache line aligned
+  * array, so passes that only need coordinates dont pull normals and
+  * colors through the cache. Normals, colors and flags are optional, their
+  * arrays stay empty when the cloud doesnt carry them.
+  */
+class PointCloud {
+  private:
+    bool                      withNormals;
+    bool                      withColors;
+    bool                      withFlags;
+
+  public:
+    AlignedVector<float>      x, y, z; ///< coordinates, always present
+    AlignedVector<float>      nx, ny, nz; ///< normals, empty if absent
+    AlignedVector<uint8_t>    r, g, b, a; ///< colors, empty if absent
+    AlignedVector<int>        flags; ///< flags, empty if absent
+
+    PointCloud(bool normals = false, bool colors = false, bool _flags = false)
+      : withNormals(normals), withColors(colors), withFlags(_flags) {}
+
+    /// Converts an array of points, copying only the requested attributes
+    static PointCloud fromPoints(const Points& points, bool normals = true,
+                                 bool colors = true, bool _flags = true);
+
+    /// Converts back to an array of points, absent attributes are zero
+    void toPoints(Points& points) const;
+
+    inline size_t size() const { return x.size(); }
+    inline bool empty() const { return x.empty(); }
+
+    inline bool hasNormals() const { return withNormals; }
+    inline bool hasColors() const { return withColors; }
+    inline bool hasFlags() const { return withFlags; }
+
+    /// Adds or drops the optional attributes
+    void setAttributes(bool normals, bool colors, bool _flags);
+
+    void resize(const size_t n);
+    void reserve(const size_t n);
+    void clear() { resize(0); }
+
+    /// Appends a point, attributes the cloud doesnt carry are dropped
+    void push_back(const Point& p);
+
+    /// Writes n points to the positions starting at offset
+    void setPoints(const size_t offset, const Point* src, const size_t n);
+
+    /// Reads n points starting at offset, absent attributes are zero
+    void getPoints(const size_t offset, const size_t n, Point* dst) const;
+
+    inline Point getPoint(const size_t i) const {
+      Point p;
+      getPoints(i, 1, &p);
+      return p;
+    }
+}; // class PointCloud
+
+
+/** \struct XYZView
+  * \brief Read only view on the coordinates of a cloud.
+  *
+  * Lets coordinate only algorithms run on both Points and PointCloud. The
+  * coordinates of point i are x[i * stride], y[i * stride], z[i * stride].
+  */
+struct XYZView {
+  const float*    x;
+  const float*    y;
+  const float*    z;
+  size_t          stride;
+  size_t          count;
+
+  XYZView(const Points& points);
+  XYZView(const PointCloud& cloud);
+
+  inline size_t size() const { return count; }
+  inline float getX(const size_t i) const { return x[i * stride]; }
+  inline float getY(const size_t i) const { return y[i * stride]; }
+  inline float getZ(const size_t i) const { return z[i * stride]; }
+};
+
+#endif // _POINT_CLOUD_H_
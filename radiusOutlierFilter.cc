@@ -0,0 +1,96 @@
+#include <radiusOutlierFilter.h>
+
+#include <algorithm>
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+RadiusOutlierFilter::RadiusOutlierFilter(const float & _radius,
+                                         const size_t & _minNeighbors)
+  : radius(_radius), minNeighbors(_minNeighbors) {
+  if(radius <= 0.0f) throwRuntimeError("Radius cannot be <= 0.0f");
+}
+
+/// keep[i] is 1 for the points with enough neighbors, returns their number
+size_t RadiusOutlierFilter::classify(const XYZView& points,
+                                     std::vector<uint8_t>& keep) const {
+  VoxelGrid voxels(radius);
+  voxels.build(points);
+  keep.assign(points.size(), 0);
+  const float sqrRadius(radius * radius);
+
+  const size_t numVoxels(voxels.numVoxels());
+  size_t numKept = 0;
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(dynamic, 64) reduction(+:numKept)
+#endif
+  for(size_t v = 0; v < numVoxels; v++) {
+    // the occupied voxels of the 3x3x3 block around v
+    uint64_t vx, vy, vz;
+    voxels.voxelCoordinates(v, vx, vy, vz);
+    size_t neighbors[27];
+    int numNeighbors = 0;
+    for(int dz = -1; dz <= 1; dz++) {
+      for(int dy = -1; dy <= 1; dy++) {
+        for(int dx = -1; dx <= 1; dx++) {
+          if((vx == 0 && dx < 0) || (vy == 0 && dy < 0) || (vz == 0 && dz < 0))
+            continue;
+          const size_t n(voxels.findVoxel(vx + dx, vy + dy, vz + dz));
+          if(n != numVoxels) neighbors[numNeighbors++] = n;
+        }
+      }
+    }
+
+    const uint32_t* ids(voxels.voxelBegin(v));
+    for(size_t k = 0; k < voxels.voxelSize(v); k++) {
+      const uint32_t id(ids[k]);
+      const float px(points.getX(id)), py(points.getY(id)),
+                  pz(points.getZ(id));
+      size_t count = 0;
+      for(int j = 0; j < numNeighbors && count < minNeighbors; j++) {
+        const uint32_t* others(voxels.voxelBegin(neighbors[j]));
+        const size_t numOthers(voxels.voxelSize(neighbors[j]));
+        for(size_t o = 0; o < numOthers && count < minNeighbors; o++) {
+          const uint32_t other(others[o]);
+          const float dx(points.getX(other) - px);
+          const float dy(points.getY(other) - py);
+          const float dz(points.getZ(other) - pz);
+          count += (other != id && dx * dx + dy * dy + dz * dz <= sqrRadius);
+        }
+      }
+      keep[id] = count >= minNeighbors;
+      numKept += keep[id];
+    }
+  }
+  return numKept;
+}
+
+void RadiusOutlierFilter::filter(const std::vector<Point>& inputPointCloud,
+                                 std::vector<Point>& resultPointCloud) {
+  if(inputPointCloud.empty())
+    throwRuntimeError("Input point cloud cant be empty");
+  std::vector<uint8_t> keep;
+  const size_t numKept(classify(XYZView(inputPointCloud), keep));
+
+  resultPointCloud.clear();
+  resultPointCloud.reserve(numKept);
+  for(size_t i = 0; i < inputPointCloud.size(); i++)
+    if(keep[i]) resultPointCloud.push_back(inputPointCloud[i]);
+  LOG << "Removed " << inputPointCloud.size() - numKept << " outliers";
+}
+
+void RadiusOutlierFilter::filter(const PointCloud& inputPointCloud,
+                                 PointCloud& resultPointCloud) {
+  if(inputPointCloud.empty())
+    throwRuntimeError("Input point cloud cant be empty");
+  std::vector<uint8_t> keep;
+  const size_t numKept(classify(XYZView(inputPointCloud), keep));
+
+  resultPointCloud = PointCloud(inputPointCloud.hasNormals(),
+                                inputPointCloud.hasColors(),
+                                inputPointCloud.hasFlags());
+  resultPointCloud.reserve(numKept);
+  for(size_t i = 0; i < inputPointCloud.size(); i++)
+    if(keep[i]) resultPointCloud.push_back(inputPointCloud.getPoint(i));
+  LOG << "Removed " << inputPointCloud.size() - numKept << " outliers";
+}
@@ -0,0 +1,44 @@
+#ifndef _RADIUS_OUTLIER_FILTER_H_
+#define _RADIUS_OUTLIER_FILTER_H_
+
+// STL
+#include <cstdint>
+#include <vector>
+
+// 3DL headers
+#include <common.h>
+#include <pointCloud.h>
+#include <voxelGrid.h>
+
+/** \class RadiusOutlierFilter
+  * \brief Removes points with too few neighbors within a radius.
+  *
+  * Bins the points into a VoxelGrid whose leaf size is the radius, so all
+  * neighbors of a point lie in its own voxel or the 26 around it. Voxels
+  * are processed in parallel and only write the flags of their own points,
+  * no locks are needed. Counting stops as soon as a point has enough
+  * neighbors, which keeps dense areas cheap.
+  */
+class RadiusOutlierFilter {
+  protected:
+    const float               radius;
+    const size_t              minNeighbors; ///< not counting the point
+
+  public:
+    RadiusOutlierFilter(const float & _radius,
+                        const size_t & _minNeighbors = 2);
+
+    void filter(const std::vector<Point>& inputPointCloud,
+                std::vector<Point>& resultPointCloud);
+
+    /// Filters a structure of arrays cloud, keeping its attributes
+    void filter(const PointCloud& inputPointCloud,
+                PointCloud& resultPointCloud);
+
+  protected:
+    /// keep[i] is 1 for the points with enough neighbors, returns their
+    /// number
+    size_t classify(const XYZView& points, std::vector<uint8_t>& keep) const;
+}; // class RadiusOutlierFilter
+
+#endif // _RADIUS_OUTLIER_FILTER_H_
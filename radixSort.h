@@ -0,0 +1,83 @@
+#ifndef _RADIX_SORT_H_
+#define _RADIX_SORT_H_
+
+// STL
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+/*! \brief Sorts keys ascending and applies the same permutation to values
+ *
+ *  Parallel least significant digit radix sort over 8 bit digits. Every
+ *  thread histograms and scatters its own contiguous block of the input, so
+ *  the sort is stable and its result doesnt depend on the thread count.
+ *  Only the keyBits low bits of the keys are considered and digits that
+ *  are the same for all keys are skipped.
+ */
+template <typename Value>
+void radixSortPairs(std::vector<uint64_t>& keys, std::vector<Value>& values,
+                    const int keyBits = 64) {
+  const size_t numKeys(keys.size());
+  if(numKeys < 2) return;
+
+  int numBlocks = 1;
+#ifdef USE_OpenMP
+  if(numKeys >= (size_t(1) << 16)) numBlocks = omp_get_max_threads();
+#endif
+  const size_t blockSize((numKeys + numBlocks - 1) / numBlocks);
+
+  std::vector<uint64_t> keysTmp(numKeys);
+  std::vector<Value>    valuesTmp(numKeys);
+  std::vector<size_t>   histograms(numBlocks * 256);
+
+  for(int shift = 0; shift < keyBits; shift += 8) {
+#ifdef USE_OpenMP
+    #pragma omp parallel for schedule(static, 1)
+#endif
+    for(int t = 0; t < numBlocks; t++) {
+      size_t* h = &histograms[t * 256];
+      std::fill(h, h + 256, 0);
+      const size_t begin(std::min(numKeys, t * blockSize));
+      const size_t end(std::min(numKeys, begin + blockSize));
+      for(size_t i = begin; i < end; i++)
+        h[(keys[i] >> shift) & 0xff]++;
+    }
+
+    // exclusive offsets in (digit, block) order keep the scatter stable
+    bool trivialDigit = false;
+    size_t sum = 0;
+    for(int d = 0; d < 256 && !trivialDigit; d++) {
+      size_t digitCount = 0;
+      for(int t = 0; t < numBlocks; t++) {
+        const size_t count(histograms[t * 256 + d]);
+        histograms[t * 256 + d] = sum;
+        sum += count;
+        digitCount += count;
+      }
+      trivialDigit = (digitCount == numKeys);
+    }
+    if(trivialDigit) continue;
+
+#ifdef USE_OpenMP
+    #pragma omp parallel for schedule(static, 1)
+#endif
+    for(int t = 0; t < numBlocks; t++) {
+      size_t* h = &histograms[t * 256];
+      const size_t begin(std::min(numKeys, t * blockSize));
+      const size_t end(std::min(numKeys, begin + blockSize));
+      for(size_t i = begin; i < end; i++) {
+        const size_t pos(h[(keys[i] >> shift) & 0xff]++);
+        keysTmp[pos] = keys[i];
+        valuesTmp[pos] = values[i];
+      }
+    }
+    keys.swap(keysTmp);
+    values.swap(valuesTmp);
+  }
+}
+
+#endif // _RADIX_SORT_H_
@@ -0,0 +1,94 @@
+#ifndef _RANDOM_H_
+#define _RANDOM_H_
+
+// STL
+#include <cstdint>
+#include <limits>
+
+/** \class Philox4x32
+  * \brief Counter based random number generator, Philox4x32-10.
+  *
+  * Every block of four outputs is a keyed bijection of a 128 bit counter
+  * (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"). The key
+  * is the seed, the counter holds the block number and three stream ids.
+  * Streams with different ids are independent and can be created anywhere
+  * without sharing state, so work item i of a parallel loop can draw from
+  * stream i and the result doesnt depend on which thread runs it.
+  * Satisfies the UniformRandomBitGenerator requirements.
+  */
+class Philox4x32 {
+  public:
+    typedef uint32_t result_type;
+
+    explicit Philox4x32(const uint64_t seed, const uint32_t stream0 = 0,
+                        const uint32_t stream1 = 0, const uint32_t stream2 = 0)
+      : used(4) {
+      key[0] = static_cast<uint32_t>(seed);
+      key[1] = static_cast<uint32_t>(seed >> 32);
+      counter[0] = 0;
+      counter[1] = stream0;
+      counter[2] = stream1;
+      counter[3] = stream2;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() {
+      return std::numeric_limits<result_type>::max();
+    }
+
+    result_type operator()() {
+      if(used == 4) {
+        generateBlock(counter, key, output);
+        counter[0]++;
+        used = 0;
+      }
+      return output[used++];
+    }
+
+    /// unbiased integer in [0, n), n > 0 (Lemire's multiply and reject)
+    uint32_t uniformInt(const uint32_t n) {
+      uint64_t product(uint64_t((*this)()) * n);
+      uint32_t low(static_cast<uint32_t>(product));
+      if(low < n) {
+        const uint32_t threshold((0u - n) % n);
+        while(low < threshold) {
+          product = uint64_t((*this)()) * n;
+          low = static_cast<uint32_t>(product);
+        }
+      }
+      return static_cast<uint32_t>(product >> 32);
+    }
+
+    /// float in [0, 1)
+    float uniformFloat() {
+      return ((*this)() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    /// One Philox4x32-10 block, exposed for checking against test vectors
+    static void generateBlock(const uint32_t in[4], const uint32_t inKey[2],
+                              uint32_t out[4]) {
+      uint32_t c[4] = {in[0], in[1], in[2], in[3]};
+      uint32_t k[2] = {inKey[0], inKey[1]};
+      for(int round = 0; round < 10; round++) {
+        const uint64_t p0(uint64_t(0xD2511F53u) * c[0]);
+        const uint64_t p1(uint64_t(0xCD9E8D57u) * c[2]);
+        const uint32_t next[4] = {
+          static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k[0],
+          static_cast<uint32_t>(p1),
+          static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k[1],
+          static_cast<uint32_t>(p0)};
+        for(int i = 0; i < 4; i++) c[i] = next[i];
+        k[0] += 0x9E3779B9u;
+        k[1] += 0xBB67AE85u;
+      }
+      for(int i = 0; i < 4; i++) out[i] = c[i];
+    }
+
+  private:
+    uint32_t    key[2];
+    uint32_t    counter[4]; ///< block number followed by the stream ids
+    uint32_t    output[4];
+    int         used; ///< outputs of the current block already returned
+};
+
+#endif // _RANDOM_H_
@@ -1,22 +1,51 @@
 #include "ransacPlaneDetection.h"
 
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+#include "linearAlgebra.h"
+
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/// hypotheses generated and ranked together
+const size_t kBatchSize = 64;
+/// points every hypothesis of a batch is ranked on
+const size_t kPreemptiveSamples = 256;
+/// hypotheses of a batch that are scored on all points
+const size_t kPreemptiveKeep = 4;
+/// attempts to find three distinct, non collinear points
+const int kSampleAttempts = 16;
+
+/// Philox stream ids, hypothesis i and the subset of the batch starting at
+/// hypothesis i draw from their own streams, so results dont depend on the
+/// number of threads
+const uint32_t kHypothesisStream = 0;
+const uint32_t kSubsetStream = 1;
+
+}  // namespace
+
 std::pair<Points, Points> RansacPlaneDetection::segment(const Points& input) {
   Points inliers;
   Points outliers;
 
-  const auto kNumPoints = input.size();
-  const auto seedId = getRandomInt(kNumPoints);
-
-  /// the point contains the normal and center of the plane
-  const auto plane = input[seedId];
-  const float planeOffset =
-      (plane.x * plane.nx) + (plane.y * plane.ny) + (plane.z * plane.nz);
+  if (input.size() > std::numeric_limits<uint32_t>::max())
+    throwRuntimeError("Cant segment more than 2^32 points");
+  std::vector<uint32_t> ids(input.size());
+  std::iota(ids.begin(), ids.end(), 0);
 
-  for (const auto p : input) {
-    const float dist = dot(plane, p) - planeOffset;
-    const float angle = find3DAngle(plane, p);
+  Plane plane;
+  if (detectPlane(input, ids.data(), ids.size(), plane) == 0) {
+    outliers = input;
+    return std::pair<Points, Points>(inliers, outliers);
+  }
 
-    if (dist < distThreshold && angle < angleThreshold) {
+  for (const auto& p : input) {
+    if (isInlier(plane, p)) {
       inliers.push_back(p);
     } else {
       outliers.push_back(p);
@@ -24,3 +53,239 @@ std::pair<Points, Points> RansacPlaneDetection::segment(const Points& input) {
   }
   return std::pair<Points, Points>(inliers, outliers);
 }
+
+std::vector<PlaneSegment> RansacPlaneDetection::detectPlanes(
+    const Points& input, std::vector<uint32_t>& ids, const size_t& maxPlanes,
+    const size_t& minInliers) {
+  if (input.size() > std::numeric_limits<uint32_t>::max())
+    throwRuntimeError("Cant segment more than 2^32 points");
+  ids.resize(input.size());
+  std::iota(ids.begin(), ids.end(), 0);
+
+  std::vector<PlaneSegment> segments;
+  size_t begin = 0;
+  while (segments.size() < maxPlanes) {
+    PlaneSegment segment;
+    const size_t count = detectPlane(input, ids.data() + begin,
+                                     ids.size() - begin, segment.plane);
+    if (count == 0 || count < minInliers) break;
+
+    const auto split = std::partition(
+        ids.begin() + begin, ids.end(),
+        [&](uint32_t id) { return isInlier(segment.plane, input[id]); });
+    segment.begin = begin;
+    segment.end = split - ids.begin();
+    begin = segment.end;
+    segments.push_back(segment);
+  }
+  return segments;
+}
+
+size_t RansacPlaneDetection::detectPlane(const Points& input,
+                                         const uint32_t* ids, size_t n,
+                                         Plane& plane) {
+  if (n < 3) return 0;
+
+  const uint32_t detection = numDetections++;
+  Plane best;
+  size_t bestCount = 0;
+  size_t required = maxIterations;
+  std::vector<Plane> hypotheses;
+  std::vector<uint8_t> valid;
+  std::vector<size_t> scores;
+  std::vector<size_t> order;
+  std::vector<uint32_t> subset(std::min(n, kPreemptiveSamples));
+
+  for (size_t iteration = 0; iteration < required;) {
+    const size_t first = iteration;
+    const size_t batch = std::min(kBatchSize, required - iteration);
+    iteration += batch;
+    hypotheses.resize(batch);
+    valid.assign(batch, 0);
+#ifdef USE_OpenMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int h = 0; h < static_cast<int>(batch); h++) {
+      Philox4x32 rng(randomSeed, kHypothesisStream, detection, first + h);
+      valid[h] = sampleHypothesis(input, ids, n, rng, hypotheses[h]);
+    }
+    size_t numValid = 0;
+    for (size_t h = 0; h < batch; h++)
+      if (valid[h]) hypotheses[numValid++] = hypotheses[h];
+    hypotheses.resize(numValid);
+    if (hypotheses.empty()) continue;
+
+    // rank on a random subset, a bad hypothesis fails there already
+    Philox4x32 rng(randomSeed, kSubsetStream, detection, first);
+    for (auto& id : subset) id = ids[rng.uniformInt(n)];
+    scores.assign(hypotheses.size(), 0);
+#ifdef USE_OpenMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int h = 0; h < static_cast<int>(hypotheses.size()); h++)
+      scores[h] = countInliers(hypotheses[h], input, subset.data(),
+                               subset.size());
+
+    order.resize(hypotheses.size());
+    std::iota(order.begin(), order.end(), 0);
+    const size_t keep = std::min(order.size(), kPreemptiveKeep);
+    std::partial_sort(order.begin(), order.begin() + keep, order.end(),
+                      [&scores](size_t a, size_t b) {
+                        return scores[a] > scores[b];
+                      });
+
+    // full scoring of the survivors, every block of points is gathered
+    // once and tested against all of them
+    std::vector<size_t> counts(keep, 0);
+    const int64_t numBlocks = (n + PointBlock::kSize - 1) / PointBlock::kSize;
+#ifdef USE_OpenMP
+#pragma omp parallel
+#endif
+    {
+      std::vector<size_t> local(keep, 0);
+      PointBlock block;
+#ifdef USE_OpenMP
+#pragma omp for schedule(static)
+#endif
+      for (int64_t b = 0; b < numBlocks; b++) {
+        const size_t begin = b * PointBlock::kSize;
+        block.gather(input, ids + begin,
+                     std::min(PointBlock::kSize, n - begin));
+        for (size_t k = 0; k < keep; k++)
+          local[k] += planeInliers(block, hypotheses[order[k]], inlierTest);
+      }
+#ifdef USE_OpenMP
+#pragma omp critical
+#endif
+      for (size_t k = 0; k < keep; k++) counts[k] += local[k];
+    }
+    for (size_t k = 0; k < keep; k++) {
+      if (counts[k] > bestCount) {
+        bestCount = counts[k];
+        best = hypotheses[order[k]];
+      }
+    }
+
+    // iterations needed to draw an all inlier sample with confidence
+    if (bestCount > 0) {
+      const double ratio = double(bestCount) / n;
+      const double allInliers = ratio * ratio * ratio;
+      if (allInliers >= 1.0) break;
+      const double needed =
+          std::ceil(std::log(1.0 - confidence) / std::log1p(-allInliers));
+      required = std::min<size_t>(
+          maxIterations, std::max<double>(needed, iteration));
+    }
+  }
+  if (bestCount == 0) return 0;
+
+  // the refit can be pulled off by points with bad normals, keep the
+  // hypothesis unless the refit is at least as good
+  const Plane refit = refitPlane(best, input, ids, n);
+  const size_t refitCount = countInliers(refit, input, ids, n);
+  if (refitCount >= bestCount) {
+    plane = refit;
+    return refitCount;
+  }
+  plane = best;
+  return bestCount;
+}
+
+bool RansacPlaneDetection::sampleHypothesis(const Points& input,
+                                            const uint32_t* ids, size_t n,
+                                            Philox4x32& rng,
+                                            Plane& plane) const {
+  for (int attempt = 0; attempt < kSampleAttempts; attempt++) {
+    const Point& a = input[ids[rng.uniformInt(n)]];
+    const Point& b = input[ids[rng.uniformInt(n)]];
+    const Point& c = input[ids[rng.uniformInt(n)]];
+
+    const double u[3] = {double(b.x) - a.x, double(b.y) - a.y,
+                         double(b.z) - a.z};
+    const double v[3] = {double(c.x) - a.x, double(c.y) - a.y,
+                         double(c.z) - a.z};
+    double normal[3];
+    linalg::cross3(u, v, normal);
+    const double length = std::sqrt(linalg::dot3(normal, normal));
+    // duplicates and collinear triples span no plane
+    if (!(length > 1e-12 * (linalg::dot3(u, u) + linalg::dot3(v, v))))
+      continue;
+
+    plane.nx = normal[0] / length;
+    plane.ny = normal[1] / length;
+    plane.nz = normal[2] / length;
+    plane.d = (plane.nx * a.x) + (plane.ny * a.y) + (plane.nz * a.z);
+
+    // the samples have to agree with the plane they span
+    if (isInlier(plane, a) && isInlier(plane, b) && isInlier(plane, c))
+      return true;
+  }
+  return false;
+}
+
+size_t RansacPlaneDetection::countInliers(const Plane& plane,
+                                          const Points& input,
+                                          const uint32_t* ids,
+                                          size_t n) const {
+  size_t count = 0;
+  PointBlock block;
+  for (size_t begin = 0; begin < n; begin += PointBlock::kSize) {
+    block.gather(input, ids + begin, std::min(PointBlock::kSize, n - begin));
+    count += planeInliers(block, plane, inlierTest);
+  }
+  return count;
+}
+
+Plane RansacPlaneDetection::refitPlane(const Plane& plane, const Points& input,
+                                       const uint32_t* ids, size_t n) const {
+  // centroid and covariance of the inliers, relative to the first inlier so
+  // large coordinates dont cancel
+  double origin[3] = {0.0, 0.0, 0.0};
+  for (size_t i = 0; i < n; i++) {
+    const Point& p = input[ids[i]];
+    if (isInlier(plane, p)) {
+      origin[0] = p.x;
+      origin[1] = p.y;
+      origin[2] = p.z;
+      break;
+    }
+  }
+
+  double count = 0.0, sx = 0.0, sy = 0.0, sz = 0.0;
+  double sxx = 0.0, sxy = 0.0, sxz = 0.0, syy = 0.0, syz = 0.0, szz = 0.0;
+#ifdef USE_OpenMP
+#pragma omp parallel for schedule(static) \
+    reduction(+ : count, sx, sy, sz, sxx, sxy, sxz, syy, syz, szz)
+#endif
+  for (int64_t i = 0; i < static_cast<int64_t>(n); i++) {
+    const Point& p = input[ids[i]];
+    if (!isInlier(plane, p)) continue;
+    const double x = p.x - origin[0];
+    const double y = p.y - origin[1];
+    const double z = p.z - origin[2];
+    count += 1.0;
+    sx += x; sy += y; sz += z;
+    sxx += x * x; sxy += x * y; sxz += x * z;
+    syy += y * y; syz += y * z; szz += z * z;
+  }
+  if (count < 3.0) return plane;
+
+  const double mx = sx / count, my = sy / count, mz = sz / count;
+  const double covariance[6] = {sxx / count - mx * mx, sxy / count - mx * my,
+                                sxz / count - mx * mz, syy / count - my * my,
+                                syz / count - my * mz, szz / count - mz * mz};
+  double eigenvalues[3], eigenvectors[3][3];
+  linalg::symmetricEigen3(covariance, eigenvalues, eigenvectors);
+
+  // normal is the direction of least variance, keep the orientation
+  const double* normal = eigenvectors[0];
+  const double sign = (normal[0] * plane.nx + normal[1] * plane.ny +
+                       normal[2] * plane.nz) < 0.0 ? -1.0 : 1.0;
+  Plane refit;
+  refit.nx = sign * normal[0];
+  refit.ny = sign * normal[1];
+  refit.nz = sign * normal[2];
+  refit.d = refit.nx * (origin[0] + mx) + refit.ny * (origin[1] + my) +
+            refit.nz * (origin[2] + mz);
+  return refit;
+}
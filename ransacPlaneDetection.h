@@ -1,49 +1,96 @@
 #pragma once
 
 #include <cmath>
-#include <random>
+#include <cstdint>
 #include <utility>
 #include <vector>
 
 #include "common.h"
+#include "planeKernels.h"
+#include "random.h"
 
+/// a plane found by RansacPlaneDetection::detectPlanes, its inliers are
+/// ids[begin..end) of the index buffer
+struct PlaneSegment {
+  Plane plane;
+  size_t begin = 0;
+  size_t end = 0;
+
+  size_t size() const { return end - begin; }
+};
+
+/** \class RansacPlaneDetection
+  * \brief Detects the dominant plane of a cloud with RANSAC.
+  *
+  * Hypotheses are planes through three random points. They are generated in
+  * batches, ranked on a small random subset of the points and only the best
+  * of every batch are scored on all points, in parallel. The number of
+  * iterations adapts to the best inlier ratio found so far and the final
+  * plane is refitted to its inliers with least squares. A point is an
+  * inlier if it is closer than distThreshold to the plane and its normal is
+  * within angleThreshold degrees of the plane normal.
+  */
 class RansacPlaneDetection {
  private:
   const unsigned int randomSeed;
   const float distThreshold;
   const float angleThreshold;
+  const unsigned int maxIterations;
+  const float confidence;
+  const PlaneInlierTest inlierTest;
+
+  /// detectPlane calls so far, every call draws from its own streams
+  uint32_t numDetections;
 
  public:
   RansacPlaneDetection(const float& distThresh, const float& angleThresh,
-                       const unsigned int& seed)
+                       const unsigned int& seed,
+                       const unsigned int& maxIter = 1000,
+                       const float& conf = 0.99f)
       : randomSeed(seed),
         distThreshold(distThresh),
-        angleThreshold(angleThresh) {}
+        angleThreshold(angleThresh),
+        maxIterations(maxIter),
+        confidence(conf),
+        inlierTest(distThresh, angleThresh),
+        numDetections(0) {}
 
+  /// Splits input into the inliers and outliers of the dominant plane
   std::pair<Points, Points> segment(const Points& input);
 
+  /** \brief Extracts up to maxPlanes planes one after the other
+   *
+   *  Every plane is detected among the points that no earlier plane took.
+   *  ids is filled with all point indices and partitioned in place: the
+   *  inliers of every plane are moved in front of the remaining points, so
+   *  nothing is copied and every round only touches the remaining points.
+   *  Stops at the first plane with less than minInliers inliers, the points
+   *  after the last returned segment are the ones left over.
+   */
+  std::vector<PlaneSegment> detectPlanes(const Points& input,
+                                         std::vector<uint32_t>& ids,
+                                         const size_t& maxPlanes,
+                                         const size_t& minInliers = 3);
+
  private:
-  unsigned int getRandomInt(const unsigned int& numPoints) {
-    static std::default_random_engine generator(randomSeed);
-    static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-    return (unsigned int)distribution(generator) * numPoints;
-  }
+  /// Finds the plane with most inliers among the points ids[0..n) of
+  /// input, returns its number of inliers, 0 if there is no plane
+  size_t detectPlane(const Points& input, const uint32_t* ids, size_t n,
+                     Plane& plane);
 
-  float dot(const Point& plane, const Point& p) {
-    return (plane.nx * p.x) + (plane.ny * p.y) + (plane.nz * p.z);
-  }
+  /// Draws three distinct points of ids[0..n) and fits a plane through them
+  bool sampleHypothesis(const Points& input, const uint32_t* ids, size_t n,
+                        Philox4x32& rng, Plane& plane) const;
+
+  /// Counts the inliers of plane among the points ids[0..n) of input
+  size_t countInliers(const Plane& plane, const Points& input,
+                      const uint32_t* ids, size_t n) const;
+
+  /// Least squares plane through the inliers of plane among ids[0..n)
+  Plane refitPlane(const Plane& plane, const Points& input,
+                   const uint32_t* ids, size_t n) const;
 
-  float find3DAngle(const Point& v1, const Point& v2) {
-    const float norm =
-        sqrt(std::pow((v1.nx - v2.nx), 2) + std::pow((v1.ny - v2.ny), 2) +
-             std::pow((v1.nz - v2.nz), 2));
-    if (norm < 0.1) return 0.0f;
-
-    const float dotProd = (v1.nx * v2.nx) + (v1.ny * v2.ny) + (v1.nz * v2.nz);
-    float theta = std::acos(dotProd) * (180 / M_PI);
-    if (theta > 90) {
-      theta -= 180;
-    }
-    return std::abs(theta);
+  bool isInlier(const Plane& plane, const Point& p) const {
+    return inlierTest.isInlier(plane, p);
   }
 };
@@ -0,0 +1,99 @@
+#include <regionGrowing.h>
+#include <unionFind.h>
+
+#include <cmath>
+#include <limits>
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+RegionGrowing::RegionGrowing(const float & _maxAngle,
+                             const float & _maxCurvature,
+                             const size_t & _numNeighbors,
+                             const size_t & _minSegmentSize)
+  : minNormalCos(std::cos(_maxAngle * float(M_PI / 180.0))),
+    maxCurvature(_maxCurvature), numNeighbors(_numNeighbors),
+    minSegmentSize(_minSegmentSize) {
+  if(numNeighbors == 0) throwRuntimeError("Need at least 1 neighbor");
+}
+
+/// Writes the segment of every point to its flags
+size_t RegionGrowing::segment(Points& points,
+                              const std::vector<float>* curvature) const {
+  if(points.empty()) throwRuntimeError("Input point cloud cant be empty");
+  if(curvature && curvature->size() != points.size())
+    throwRuntimeError("Need one curvature per point");
+  const size_t n(points.size());
+
+  // the point itself is its own nearest neighbor
+  KdTree tree;
+  tree.build(XYZView(points));
+  std::vector<uint32_t> ids;
+  std::vector<float> sqrDistances;
+  const size_t k(tree.knnBatch(XYZView(points), numNeighbors + 1, ids,
+                               sqrDistances));
+
+  auto smooth = [curvature, this](const size_t i) {
+    return !curvature || (*curvature)[i] <= maxCurvature;
+  };
+  auto compatible = [&points, this](const size_t i, const size_t j) {
+    const Point& a = points[i];
+    const Point& b = points[j];
+    return std::abs(a.nx * b.nx + a.ny * b.ny + a.nz * b.nz) >= minNormalCos;
+  };
+
+  UnionFind sets(n);
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(dynamic, 1024)
+#endif
+  for(size_t i = 0; i < n; i++) {
+    if(!smooth(i)) continue;
+    const uint32_t* row(ids.data() + i * k);
+    for(size_t c = 0; c < k; c++) {
+      const uint32_t j(row[c]);
+      if(j != i && smooth(j) && compatible(i, j)) sets.unite(i, j);
+    }
+  }
+
+  // segment root of every point, the rough ones take the root of their
+  // nearest compatible smooth neighbor
+  const uint32_t kNone(std::numeric_limits<uint32_t>::max());
+  std::vector<uint32_t> roots(n);
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(dynamic, 1024)
+#endif
+  for(size_t i = 0; i < n; i++) {
+    if(smooth(i)) {
+      roots[i] = sets.find(i);
+      continue;
+    }
+    roots[i] = kNone;
+    const uint32_t* row(ids.data() + i * k);
+    for(size_t c = 0; c < k; c++) {
+      const uint32_t j(row[c]);
+      if(j != i && smooth(j) && compatible(i, j)) {
+        roots[i] = sets.find(j);
+        break;
+      }
+    }
+  }
+
+  // number the segments by their root, which is their first smooth point
+  std::vector<int> labels(n, 0);
+  for(size_t i = 0; i < n; i++)
+    if(roots[i] != kNone) labels[roots[i]]++;
+  int numSegments = 0;
+  for(size_t i = 0; i < n; i++) {
+    const size_t size(labels[i]);
+    labels[i] = size > 0 && size >= minSegmentSize ? numSegments++ : -1;
+  }
+
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for(size_t i = 0; i < n; i++)
+    points[i].flags = roots[i] == kNone ? -1 : labels[roots[i]];
+
+  LOG << "Found " << numSegments << " segments";
+  return numSegments;
+}
@@ -0,0 +1,51 @@
+#ifndef _REGION_GROWING_H_
+#define _REGION_GROWING_H_
+
+// STL
+#include <cstdint>
+#include <vector>
+
+// 3DL headers
+#include <common.h>
+#include <kdTree.h>
+
+/** \class RegionGrowing
+  * \brief Segments a cloud into smooth surfaces over its kNN graph.
+  *
+  * Two neighbors belong to the same segment if the angle between their
+  * normals is below maxAngle. Like in classic seeded region growing only
+  * points with a curvature below maxCurvature keep growing, points above it
+  * join the segment of a smooth neighbor but dont connect segments.
+  *
+  * Instead of a serial breadth first search from one seed at a time, all
+  * points expand their neighborhood at once: the smooth points unite their
+  * compatible smooth neighbors in a lock-free UnionFind in parallel, then
+  * every other point attaches to its nearest compatible smooth neighbor.
+  * The segments are the sets of the union-find, numbered in the order of
+  * their first point, so the labels dont depend on the thread count.
+  */
+class RegionGrowing {
+  protected:
+    const float               minNormalCos; ///< cosine of maxAngle
+    const float               maxCurvature;
+    const size_t              numNeighbors;
+    const size_t              minSegmentSize;
+
+  public:
+    RegionGrowing(const float & _maxAngle = 5.0f,
+                  const float & _maxCurvature = 0.05f,
+                  const size_t & _numNeighbors = 16,
+                  const size_t & _minSegmentSize = 1);
+
+    /** Writes the segment of every point to its flags
+     *
+     *  points need normals, their orientation doesnt matter. curvature is
+     *  e.g. the one of NormalEstimation::compute, without it every point
+     *  counts as smooth. Points in segments smaller than minSegmentSize get
+     *  the flag -1. Returns the number of segments.
+     */
+    size_t segment(Points& points,
+                   const std::vector<float>* curvature = nullptr) const;
+}; // class RegionGrowing
+
+#endif // _REGION_GROWING_H_
@@ -0,0 +1,175 @@
+#include <statisticalOutlierFilter.h>
+
+#include <algorithm>
+#include <cmath>
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/// points per block of the statistics and the compaction
+const size_t kBlockSize = size_t(1) << 16;
+
+/// running mean and sum of squared deviations (Welford)
+struct RunningStats {
+  double              count = 0.0;
+  double              mean = 0.0;
+  double              m2 = 0.0;
+
+  void add(const double v) {
+    count += 1.0;
+    const double delta(v - mean);
+    mean += delta / count;
+    m2 += delta * (v - mean);
+  }
+
+  /// combines two blocks (Chan et al.)
+  void merge(const RunningStats& other) {
+    if(other.count == 0.0) return;
+    const double total(count + other.count);
+    const double delta(other.mean - mean);
+    mean += delta * other.count / total;
+    m2 += other.m2 + delta * delta * count * other.count / total;
+    count = total;
+  }
+};
+
+} // namespace
+
+StatisticalOutlierFilter::StatisticalOutlierFilter(
+    const size_t & _numNeighbors, const float & _stddevMultiplier)
+  : numNeighbors(_numNeighbors), stddevMultiplier(_stddevMultiplier) {
+  if(numNeighbors == 0) throwRuntimeError("Number of neighbors cannot be 0");
+}
+
+/// Mean distance of every point to its numNeighbors nearest neighbors
+void StatisticalOutlierFilter::meanDistances(const XYZView& points,
+    std::vector<float>& distances) const {
+  const size_t n(points.size());
+  distances.assign(n, 0.0f);
+  KdTree tree;
+  tree.build(points);
+
+#ifdef USE_OpenMP
+  #pragma omp parallel
+#endif
+  {
+    // the nearest result is the point itself
+    std::vector<uint32_t> ids(numNeighbors + 1);
+    std::vector<float> sqrDistances(numNeighbors + 1);
+#ifdef USE_OpenMP
+    #pragma omp for schedule(dynamic, 256)
+#endif
+    for(size_t i = 0; i < n; i++) {
+      const size_t found(tree.knn(points.getX(i), points.getY(i),
+                                  points.getZ(i), numNeighbors + 1,
+                                  ids.data(), sqrDistances.data()));
+      double sum = 0.0;
+      for(size_t j = 1; j < found; j++) sum += std::sqrt(sqrDistances[j]);
+      distances[i] = found > 1 ? static_cast<float>(sum / (found - 1)) : 0.0f;
+    }
+  }
+}
+
+/// keep[i] is 1 for the points that arent outliers, returns their number
+size_t StatisticalOutlierFilter::classify(const XYZView& points,
+                                          std::vector<uint8_t>& keep) const {
+  std::vector<float> distances;
+  meanDistances(points, distances);
+  const size_t n(distances.size());
+
+  const size_t numBlocks((n + kBlockSize - 1) / kBlockSize);
+  std::vector<RunningStats> blocks(numBlocks);
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(static, 1)
+#endif
+  for(size_t b = 0; b < numBlocks; b++) {
+    const size_t end(std::min(n, (b + 1) * kBlockSize));
+    for(size_t i = b * kBlockSize; i < end; i++) blocks[b].add(distances[i]);
+  }
+  RunningStats stats;
+  for(const RunningStats& block : blocks) stats.merge(block);
+
+  const double stddev(stats.count > 1.0
+                      ? std::sqrt(stats.m2 / (stats.count - 1.0)) : 0.0);
+  const double threshold(stats.mean + stddevMultiplier * stddev);
+  DEBUG << "Mean neighbor distance " << stats.mean << ", stddev " << stddev;
+
+  keep.resize(n);
+  size_t numKept = 0;
+#ifdef USE_OpenMP
+  #pragma omp parallel for reduction(+:numKept)
+#endif
+  for(size_t i = 0; i < n; i++) {
+    keep[i] = distances[i] <= threshold;
+    numKept += keep[i];
+  }
+  return numKept;
+}
+
+void StatisticalOutlierFilter::filter(
+    const std::vector<Point>& inputPointCloud,
+    std::vector<Point>& resultPointCloud) {
+  if(inputPointCloud.empty())
+    throwRuntimeError("Input point cloud cant be empty");
+  std::vector<uint8_t> keep;
+  const size_t numKept(classify(XYZView(inputPointCloud), keep));
+
+  resultPointCloud.clear();
+  resultPointCloud.reserve(numKept);
+  for(size_t i = 0; i < inputPointCloud.size(); i++)
+    if(keep[i]) resultPointCloud.push_back(inputPointCloud[i]);
+  LOG << "Removed " << inputPointCloud.size() - numKept << " outliers";
+}
+
+void StatisticalOutlierFilter::filter(const PointCloud& inputPointCloud,
+                                      PointCloud& resultPointCloud) {
+  if(inputPointCloud.empty())
+    throwRuntimeError("Input point cloud cant be empty");
+  std::vector<uint8_t> keep;
+  const size_t n(inputPointCloud.size());
+  const size_t numKept(classify(XYZView(inputPointCloud), keep));
+
+  // output position of every block, then the blocks copy in parallel
+  const size_t numBlocks((n + kBlockSize - 1) / kBlockSize);
+  std::vector<size_t> offsets(numBlocks + 1, 0);
+  for(size_t b = 0; b < numBlocks; b++) {
+    const size_t end(std::min(n, (b + 1) * kBlockSize));
+    offsets[b + 1] = offsets[b]
+        + std::count(keep.begin() + b * kBlockSize, keep.begin() + end, 1);
+  }
+
+  resultPointCloud = PointCloud(inputPointCloud.hasNormals(),
+                                inputPointCloud.hasColors(),
+                                inputPointCloud.hasFlags());
+  resultPointCloud.resize(numKept);
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(static, 1)
+#endif
+  for(size_t b = 0; b < numBlocks; b++) {
+    const size_t end(std::min(n, (b + 1) * kBlockSize));
+    size_t pos(offsets[b]);
+    for(size_t i = b * kBlockSize; i < end; i++) {
+      if(!keep[i]) continue;
+      const Point p(inputPointCloud.getPoint(i));
+      resultPointCloud.setPoints(pos++, &p, 1);
+    }
+  }
+  LOG << "Removed " << n - numKept << " outliers";
+}
+
+/// Removes the outliers from points without a second copy, keeping the
+/// order, returns the number of points left
+size_t StatisticalOutlierFilter::filterInPlace(std::vector<Point>& points) {
+  if(points.empty()) return 0;
+  std::vector<uint8_t> keep;
+  classify(XYZView(points), keep);
+
+  size_t numKept = 0;
+  for(size_t i = 0; i < points.size(); i++)
+    if(keep[i]) points[numKept++] = points[i];
+  LOG << "Removed " << points.size() - numKept << " outliers";
+  points.resize(numKept);
+  return numKept;
+}
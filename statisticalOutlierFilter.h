@@ -0,0 +1,52 @@
+#ifndef _STATISTICAL_OUTLIER_FILTER_H_
+#define _STATISTICAL_OUTLIER_FILTER_H_
+
+// STL
+#include <cstdint>
+#include <vector>
+
+// 3DL headers
+#include <common.h>
+#include <pointCloud.h>
+#include <kdTree.h>
+
+/** \class StatisticalOutlierFilter
+  * \brief Removes points far from their neighbors compared to the cloud.
+  *
+  * Computes the mean distance of every point to its k nearest neighbors
+  * with batched KdTree queries, then the mean and standard deviation of
+  * these distances over the cloud. Points whose mean distance exceeds
+  * mean + stddevMultiplier * stddev are outliers. The statistics are
+  * accumulated with Welford's update per block of points and the blocks
+  * are merged in order, so the result is the same for any thread count.
+  */
+class StatisticalOutlierFilter {
+  protected:
+    const size_t              numNeighbors;
+    const float               stddevMultiplier;
+
+  public:
+    StatisticalOutlierFilter(const size_t & _numNeighbors = 8,
+                             const float & _stddevMultiplier = 1.0f);
+
+    void filter(const std::vector<Point>& inputPointCloud,
+                std::vector<Point>& resultPointCloud);
+
+    /// Filters a structure of arrays cloud, keeping its attributes
+    void filter(const PointCloud& inputPointCloud,
+                PointCloud& resultPointCloud);
+
+    /// Removes the outliers from points without a second copy, keeping the
+    /// order, returns the number of points left
+    size_t filterInPlace(std::vector<Point>& points);
+
+    /// Mean distance of every point to its numNeighbors nearest neighbors
+    void meanDistances(const XYZView& points,
+                       std::vector<float>& distances) const;
+
+  protected:
+    /// keep[i] is 1 for the points that arent outliers, returns their number
+    size_t classify(const XYZView& points, std::vector<uint8_t>& keep) const;
+}; // class StatisticalOutlierFilter
+
+#endif // _STATISTICAL_OUTLIER_FILTER_H_
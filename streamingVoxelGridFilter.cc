@@ -0,0 +1,269 @@
+#include <streamingVoxelGridFilter.h>
+#include <file_system.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+namespace {
+
+/// points read from the input or a bucket file at once
+const size_t kChunkPoints = size_t(1) << 16;
+
+/// rough working set of VoxelGridFilter per point: the point, its sort
+/// keys, ids and the temporary buffers of the radix sort
+const size_t kBytesPerPoint = sizeof(Point) + 48;
+
+/// reads up to kChunkPoints points, returns false once the input is done
+bool readChunk(PlyReader& reader, Points& chunk) {
+  chunk.clear();
+  Point p;
+  while(chunk.size() < kChunkPoints && reader.readPoint(p))
+    chunk.push_back(p);
+  return !chunk.empty();
+}
+
+/// reads up to kChunkPoints raw points, returns false once the file is done
+bool readChunk(std::ifstream& file, Points& chunk) {
+  chunk.resize(kChunkPoints);
+  file.read(reinterpret_cast<char*>(chunk.data()),
+            kChunkPoints * sizeof(Point));
+  chunk.resize(file.gcount() / sizeof(Point));
+  return !chunk.empty();
+}
+
+} // namespace
+
+StreamingVoxelGridFilter::StreamingVoxelGridFilter(const float & _leafSize,
+    const VoxelReduction & _reduction, const size_t & _memoryBudget,
+    const std::string & _tempFolder)
+  : leafSize(_leafSize), reduction(_reduction), memoryBudget(_memoryBudget),
+    tempFolder(_tempFolder), numBucketFiles(0) {
+  if(leafSize <= 0.0f) throwRuntimeError("Leaf size cannot be <= 0.0f");
+  if(maxBucketPoints() < kChunkPoints)
+    throwRuntimeError("Memory budget too small");
+}
+
+/// largest number of points filtered in memory at once
+size_t StreamingVoxelGridFilter::maxBucketPoints() const {
+  return memoryBudget / kBytesPerPoint;
+}
+
+/// Downsamples inputFile into outputFile, returns the number of points
+size_t StreamingVoxelGridFilter::filter(const std::string& inputFile,
+    const std::string& outputFile) {
+  // first pass: bounds of the cloud define the global grid
+  float minP[3], maxP[3];
+  for(int a = 0; a < 3; a++) {
+    minP[a] = std::numeric_limits<float>::max();
+    maxP[a] = std::numeric_limits<float>::lowest();
+  }
+  size_t numPoints = 0;
+  bool normals, colors, flags;
+  {
+    PlyReader reader(inputFile);
+    normals = reader.hasProperty(PlyPropertyTypes::kNX);
+    colors  = reader.hasProperty(PlyPropertyTypes::kR);
+    flags   = reader.hasProperty(PlyPropertyTypes::kFlags);
+    Points chunk;
+    while(readChunk(reader, chunk)) {
+      for(const Point& p : chunk) {
+        minP[0] = std::min(minP[0], p.x); maxP[0] = std::max(maxP[0], p.x);
+        minP[1] = std::min(minP[1], p.y); maxP[1] = std::max(maxP[1], p.y);
+        minP[2] = std::min(minP[2], p.z); maxP[2] = std::max(maxP[2], p.z);
+      }
+      numPoints += chunk.size();
+    }
+  }
+  if(numPoints == 0) throwRuntimeError("Input point cloud cant be empty");
+
+  int longestAxis = 0;
+  for(int a = 0; a < 3; a++) {
+    origin[a] = minP[a];
+    const double count(std::floor((double(maxP[a]) - minP[a]) / leafSize) + 1);
+    if(!(count < std::ldexp(1.0, 62)))
+      throwRuntimeError("Voxel grid extent exceeds the 64 bit key space");
+    numVoxels[a] = static_cast<uint64_t>(count);
+    if(numVoxels[a] > numVoxels[longestAxis]) longestAxis = a;
+  }
+
+  const bool createdFolder(!stlplus::folder_exists(tempFolder));
+  if(createdFolder && !stlplus::folder_create(tempFolder))
+    throwRuntimeError("Cant create temporary folder " + tempFolder);
+
+  const std::string resultsFile(
+      stlplus::create_filespec(tempFolder, "results.bin"));
+  std::ofstream results(resultsFile.c_str(),
+                        std::ofstream::out | std::ofstream::binary);
+  if(!results.is_open())
+    throwRuntimeError("Cant open temporary file " + resultsFile);
+
+  size_t numResults = 0;
+  if(numPoints <= maxBucketPoints()) {
+    // fits the budget, no need to spill
+    PlyReader reader(inputFile);
+    reader.readFile();
+    numResults += filterBucket(reader.points, results);
+  } else {
+    // second pass: spill the input into slabs along the longest axis
+    Bucket whole;
+    for(int a = 0; a < 3; a++) {
+      whole.lo[a] = 0;
+      whole.hi[a] = numVoxels[a];
+    }
+    whole.count = numPoints;
+    std::vector<Bucket> pending(splitBucket(whole,
+        (2 * numPoints + maxBucketPoints() - 1) / maxBucketPoints()));
+    {
+      const size_t bufferPoints(std::max<size_t>(1024,
+          memoryBudget / 2 / sizeof(Point) / pending.size()));
+      std::vector<Points> buffers(pending.size());
+      PlyReader reader(inputFile);
+      Points chunk;
+      while(readChunk(reader, chunk))
+        spill(chunk, longestAxis, pending, buffers, bufferPoints);
+      for(size_t b = 0; b < pending.size(); b++)
+        flushBucket(pending[b], buffers[b]);
+    }
+
+    // filter the buckets that fit the budget, split the others again
+    while(!pending.empty()) {
+      Bucket bucket(pending.back());
+      pending.pop_back();
+      if(bucket.count == 0) continue;
+
+      std::ifstream file(bucket.file.c_str(),
+                         std::ifstream::in | std::ifstream::binary);
+      if(!file.is_open())
+        throwRuntimeError("Cant open temporary file " + bucket.file);
+
+      int axis = 0;
+      for(int a = 0; a < 3; a++)
+        if(bucket.hi[a] - bucket.lo[a] > bucket.hi[axis] - bucket.lo[axis])
+          axis = a;
+
+      if(bucket.count <= maxBucketPoints()
+          || bucket.hi[axis] - bucket.lo[axis] == 1) {
+        if(bucket.count > maxBucketPoints())
+          LOG << "Bucket of " << bucket.count << " points in a single "
+              << "voxel layer exceeds the memory budget";
+        Points points;
+        points.reserve(bucket.count);
+        Points chunk;
+        while(readChunk(file, chunk))
+          points.insert(points.end(), chunk.begin(), chunk.end());
+        numResults += filterBucket(points, results);
+      } else {
+        std::vector<Bucket> parts(splitBucket(bucket,
+            (2 * bucket.count + maxBucketPoints() - 1) / maxBucketPoints()));
+        const size_t bufferPoints(std::max<size_t>(1024,
+            memoryBudget / 2 / sizeof(Point) / parts.size()));
+        std::vector<Points> buffers(parts.size());
+        Points chunk;
+        while(readChunk(file, chunk))
+          spill(chunk, axis, parts, buffers, bufferPoints);
+        for(size_t b = 0; b < parts.size(); b++)
+          flushBucket(parts[b], buffers[b]);
+        pending.insert(pending.end(), parts.begin(), parts.end());
+      }
+      file.close();
+      stlplus::file_delete(bucket.file);
+    }
+  }
+  results.close();
+  if(results.fail()) throwRuntimeError("Failed writing " + resultsFile);
+
+  // stream the results out now that their number is known
+  {
+    PlyWriter writer(outputFile);
+    writer.addVertexElement(true, normals, colors, flags);
+    writer.setPointsCount(numResults);
+    writer.writeHeader();
+    std::ifstream file(resultsFile.c_str(),
+                       std::ifstream::in | std::ifstream::binary);
+    Points chunk;
+    while(readChunk(file, chunk))
+      writer.writePoints(chunk.data(), chunk.size());
+    writer.closeFile();
+  }
+  stlplus::file_delete(resultsFile);
+  if(createdFolder) stlplus::folder_delete(tempFolder);
+
+  LOG << "Downsampled " << numPoints << " points to " << numResults;
+  return numResults;
+}
+
+/// splits bucket into parts slabs along its longest axis
+std::vector<StreamingVoxelGridFilter::Bucket>
+StreamingVoxelGridFilter::splitBucket(const Bucket& bucket,
+                                      const size_t parts) {
+  int axis = 0;
+  for(int a = 0; a < 3; a++)
+    if(bucket.hi[a] - bucket.lo[a] > bucket.hi[axis] - bucket.lo[axis])
+      axis = a;
+  const uint64_t extent(bucket.hi[axis] - bucket.lo[axis]);
+  const uint64_t numParts(std::max<uint64_t>(1,
+      std::min<uint64_t>(extent, parts)));
+
+  std::vector<Bucket> result(numParts, bucket);
+  for(uint64_t b = 0; b < numParts; b++) {
+    Bucket& part = result[b];
+    // boundaries in double, extent * b may not fit 64 bits
+    part.lo[axis] = bucket.lo[axis]
+        + static_cast<uint64_t>(double(extent) * b / numParts);
+    part.hi[axis] = b + 1 == numParts ? bucket.hi[axis] : bucket.lo[axis]
+        + static_cast<uint64_t>(double(extent) * (b + 1) / numParts);
+    part.count = 0;
+    std::ostringstream name;
+    name << "bucket_" << numBucketFiles++ << ".bin";
+    part.file = stlplus::create_filespec(tempFolder, name.str());
+    // truncate leftovers of earlier runs
+    std::ofstream(part.file.c_str(), std::ofstream::out | std::ofstream::binary);
+  }
+  return result;
+}
+
+/// routes points to the buckets, all split along the same axis
+void StreamingVoxelGridFilter::spill(const Points& points, const int axis,
+    std::vector<Bucket>& buckets, std::vector<Points>& buffers,
+    const size_t bufferPoints) {
+  std::vector<uint64_t> starts(buckets.size());
+  for(size_t b = 0; b < buckets.size(); b++)
+    starts[b] = buckets[b].lo[axis];
+
+  for(const Point& p : points) {
+    const uint64_t v(voxelIndex(p, axis));
+    const size_t b(std::upper_bound(starts.begin(), starts.end(), v)
+                   - starts.begin() - 1);
+    buffers[b].push_back(p);
+    if(buffers[b].size() >= bufferPoints)
+      flushBucket(buckets[b], buffers[b]);
+  }
+}
+
+/// appends buffer to the file of bucket and clears it
+void StreamingVoxelGridFilter::flushBucket(Bucket& bucket, Points& buffer) {
+  if(buffer.empty()) return;
+  // files are only open while flushing, so the bucket count isnt limited
+  // by the number of open files
+  std::ofstream file(bucket.file.c_str(), std::ofstream::out
+                     | std::ofstream::binary | std::ofstream::app);
+  file.write(reinterpret_cast<const char*>(buffer.data()),
+             buffer.size() * sizeof(Point));
+  if(file.fail()) throwRuntimeError("Failed writing " + bucket.file);
+  bucket.count += buffer.size();
+  buffer.clear();
+}
+
+/// downsamples points and appends the result to the results stream
+size_t StreamingVoxelGridFilter::filterBucket(const Points& points,
+                                              std::ofstream& results) {
+  if(points.empty()) return 0;
+  VoxelGridFilter vgf(leafSize, reduction);
+  vgf.setGridOrigin(origin[0], origin[1], origin[2]);
+  Points filtered;
+  vgf.filter(points, filtered);
+  results.write(reinterpret_cast<const char*>(filtered.data()),
+                filtered.size() * sizeof(Point));
+  return filtered.size();
+}
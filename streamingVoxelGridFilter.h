@@ -0,0 +1,82 @@
+#ifndef _STREAMING_VOXEL_GRID_FILTER_H_
+#define _STREAMING_VOXEL_GRID_FILTER_H_
+
+// STL
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// 3DL headers
+#include <common.h>
+#include <plyIO.h>
+#include <voxelGridFilter.h>
+
+/** \class StreamingVoxelGridFilter
+  * \brief Out of core voxel grid downsampling of PLY files.
+  *
+  * Streams the input through PlyReader::readPoint and spills the points to
+  * temporary files, one per spatial bucket of whole voxels. Buckets that
+  * dont fit the memory budget are split again. Every bucket is then
+  * downsampled with VoxelGridFilter on the global grid and the results are
+  * streamed out through PlyWriter, so peak memory is bounded by the budget
+  * instead of the input size.
+  */
+class StreamingVoxelGridFilter {
+  protected:
+    const float               leafSize;
+    const VoxelReduction      reduction;
+    const size_t              memoryBudget; ///< bytes
+    const std::string         tempFolder;
+
+    /// a box of voxels and the file holding its points
+    struct Bucket {
+      uint64_t                lo[3]; ///< first voxel on each axis
+      uint64_t                hi[3]; ///< one past the last voxel
+      std::string             file;
+      size_t                  count;
+    };
+
+    // global grid, set up by the first pass
+    float                     origin[3];
+    uint64_t                  numVoxels[3];
+    size_t                    numBucketFiles;
+
+  public:
+    StreamingVoxelGridFilter(const float & _leafSize,
+        const VoxelReduction & _reduction = VoxelReduction::kMean,
+        const size_t & _memoryBudget = size_t(1) << 30,
+        const std::string & _tempFolder = "./voxelGridFilterTmp");
+
+    /// Downsamples inputFile into outputFile, returns the number of points
+    size_t filter(const std::string& inputFile, const std::string& outputFile);
+
+  protected:
+    /// largest number of points filtered in memory at once
+    size_t maxBucketPoints() const;
+
+    /// voxel index of p along axis
+    inline uint64_t voxelIndex(const Point& p, const int axis) const {
+      const float c(axis == 0 ? p.x : (axis == 1 ? p.y : p.z));
+      const float v(std::max(0.0f, (c - origin[axis]) / leafSize));
+      return std::min<uint64_t>(numVoxels[axis] - 1,
+                                static_cast<uint64_t>(v));
+    }
+
+    /// splits bucket into parts slabs along its longest axis
+    std::vector<Bucket> splitBucket(const Bucket& bucket, const size_t parts);
+
+    /// routes points to the buckets, all split along the same axis
+    void spill(const Points& points, const int axis,
+               std::vector<Bucket>& buckets,
+               std::vector<Points>& buffers, const size_t bufferPoints);
+
+    /// appends buffer to the file of bucket and clears it
+    void flushBucket(Bucket& bucket, Points& buffer);
+
+    /// downsamples points and appends the result to the results stream
+    size_t filterBucket(const Points& points, std::ofstream& results);
+}; // class StreamingVoxelGridFilter
+
+#endif // _STREAMING_VOXEL_GRID_FILTER_H_
@@ -53,6 +53,20 @@ struct Face {
   int32_t                   flags;
 };
 
+/*! \brief Plane of the points p with n . p = d
+ *
+ *  The normal n has unit length, so distance is the signed euclidean
+ *  distance.
+ */
+struct Plane {
+  float       nx = 0.0f, ny = 0.0f, nz = 1.0f;
+  float       d = 0.0f;
+
+  float distance(const Point& p) const {
+    return ((nx * p.x) + (ny * p.y) + (nz * p.z)) - d;
+  }
+};
+
 using Points = std::vector<Point>;
 using Faces  = std::vector<Face>;
 
@@ -0,0 +1,75 @@
+#ifndef _UNION_FIND_H_
+#define _UNION_FIND_H_
+
+// STL
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/** \class UnionFind
+  * \brief Lock-free disjoint sets of the elements 0..n-1.
+  *
+  * Parents are atomics, unite links the larger of two roots below the
+  * smaller one with a compare and swap and retries if another thread
+  * relinked the root first, find compresses paths by halving. The root of
+  * every set is therefore its smallest element, whatever order threads
+  * unite in, so labels derived from the roots are deterministic. unite and
+  * find may run concurrently from any number of threads.
+  */
+class UnionFind {
+  private:
+    std::unique_ptr<std::atomic<uint32_t>[]> parents;
+    size_t                    n;
+
+  public:
+    explicit UnionFind(const size_t _n = 0) { reset(_n); }
+
+    /// Puts every element of 0.._n-1 in its own set
+    void reset(const size_t _n) {
+      n = _n;
+      parents.reset(new std::atomic<uint32_t>[n]);
+      for(size_t i = 0; i < n; i++)
+        parents[i].store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+    }
+
+    inline size_t size() const { return n; }
+
+    /// root of the set of i
+    uint32_t find(uint32_t i) {
+      uint32_t parent(parents[i].load(std::memory_order_relaxed));
+      while(parent != i) {
+        // halving, point i at its grandparent, losing the race is harmless
+        const uint32_t grandparent(parents[parent].load(
+            std::memory_order_relaxed));
+        if(grandparent != parent)
+          parents[i].compare_exchange_weak(parent, grandparent,
+                                           std::memory_order_relaxed);
+        i = parent;
+        parent = parents[i].load(std::memory_order_relaxed);
+      }
+      return i;
+    }
+
+    /// Merges the sets of a and b, returns false if they already were one
+    bool unite(uint32_t a, uint32_t b) {
+      while(true) {
+        a = find(a);
+        b = find(b);
+        if(a == b) return false;
+        if(a > b) std::swap(a, b);
+        // b is a root as long as its parent is still b
+        uint32_t expected(b);
+        if(parents[b].compare_exchange_strong(expected, a,
+                                              std::memory_order_relaxed))
+          return true;
+      }
+    }
+
+    inline bool same(const uint32_t a, const uint32_t b) {
+      return find(a) == find(b);
+    }
+}; // class UnionFind
+
+#endif // _UNION_FIND_H_
@@ -0,0 +1,200 @@
+#include <voxelGrid.h>
+#include <radixSort.h>
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#ifdef USE_OpenMP
+#include <omp.h>
+#endif
+
+VoxelGrid::VoxelGrid(const float & _leafSize)
+  : leafSize(_leafSize), minX(0), minY(0), minZ(0), fixedOrigin(false),
+    numVoxelX(0), numVoxelY(0), numVoxelZ(0),
+    numTileX(1), numTileY(1), numTileZ(1) {
+  if(leafSize <= 0.0f) throwRuntimeError("Leaf size cannot be <= 0.0f");
+}
+
+/// Bins the points, replacing any previous binning
+void VoxelGrid::build(const XYZView& points) {
+  const size_t numPoints(points.size());
+  if(numPoints > std::numeric_limits<uint32_t>::max())
+    throwRuntimeError("Too many points for voxel binning");
+
+  keys.clear();
+  tiles.clear();
+  starts.assign(1, 0);
+  ids.clear();
+  if(numPoints == 0) return;
+
+  // finding min max
+  float x0 = std::numeric_limits<float>::max();
+  float y0 = std::numeric_limits<float>::max();
+  float z0 = std::numeric_limits<float>::max();
+  float x1 = std::numeric_limits<float>::lowest();
+  float y1 = std::numeric_limits<float>::lowest();
+  float z1 = std::numeric_limits<float>::lowest();
+#ifdef USE_OpenMP
+  #pragma omp parallel for reduction(min:x0,y0,z0) reduction(max:x1,y1,z1)
+#endif
+  for (size_t i = 0; i < numPoints; i++) {
+    const float x(points.getX(i)), y(points.getY(i)), z(points.getZ(i));
+    x0 = std::min(x0, x); y0 = std::min(y0, y); z0 = std::min(z0, z);
+    x1 = std::max(x1, x); y1 = std::max(y1, y); z1 = std::max(z1, z);
+  }
+  if(fixedOrigin) {
+    x0 = minX; y0 = minY; z0 = minZ;
+  }
+  minX = x0; minY = y0; minZ = z0;
+
+  // the voxel counts and the number of tiles have to fit 64 bit integers
+  const double maxCount(std::ldexp(1.0, 62));
+  const double extentX(std::max(0.0, double(x1) - x0));
+  const double extentY(std::max(0.0, double(y1) - y0));
+  const double extentZ(std::max(0.0, double(z1) - z0));
+  const double countX(std::floor(extentX / leafSize) + 1);
+  const double countY(std::floor(extentY / leafSize) + 1);
+  const double countZ(std::floor(extentZ / leafSize) + 1);
+  if(!(countX < maxCount && countY < maxCount && countZ < maxCount))
+    throwRuntimeError("Voxel grid extent exceeds the 64 bit key space");
+  numVoxelX = static_cast<uint64_t>(countX);
+  numVoxelY = static_cast<uint64_t>(countY);
+  numVoxelZ = static_cast<uint64_t>(countZ);
+
+  numTileX = (numVoxelX + kMortonAxisSize - 1) >> kMortonAxisBits;
+  numTileY = (numVoxelY + kMortonAxisSize - 1) >> kMortonAxisBits;
+  numTileZ = (numVoxelZ + kMortonAxisSize - 1) >> kMortonAxisBits;
+  if(double(numTileX) * double(numTileY) * double(numTileZ) >= maxCount)
+    throwRuntimeError("Voxel grid extent exceeds the 64 bit key space");
+  const bool tiled(isTiled());
+  if(tiled)
+    DEBUG << "Voxel grid split into " << numTileX << "x" << numTileY
+          << "x" << numTileZ << " tiles";
+
+  // Morton code of every point's voxel inside its tile
+  std::vector<uint64_t> pointKeys(numPoints);
+  ids.resize(numPoints);
+#ifdef USE_OpenMP
+  #pragma omp parallel for
+#endif
+  for (size_t i = 0; i < numPoints; i++) {
+    uint64_t x, y, z;
+    pointVoxel(points, i, x, y, z);
+    pointKeys[i] = mortonEncode3(x, y, z);
+    ids[i] = static_cast<uint32_t>(i);
+  }
+
+  // only sort the bits the largest coordinate can occupy
+  const uint64_t maxCoordinate(std::min(kMortonAxisSize,
+      std::max(numVoxelX, std::max(numVoxelY, numVoxelZ))) - 1);
+  int axisBits = 0;
+  while(axisBits < kMortonAxisBits && (maxCoordinate >> axisBits) != 0)
+    axisBits++;
+  radixSortPairs(pointKeys, ids, 3 * axisBits);
+
+  // tiled grids: a stable sort by tile on top orders by (tile, key)
+  std::vector<uint64_t> pointTiles;
+  if(tiled) {
+    pointTiles.resize(numPoints);
+#ifdef USE_OpenMP
+    #pragma omp parallel for
+#endif
+    for (size_t k = 0; k < numPoints; k++) {
+      uint64_t x, y, z;
+      pointVoxel(points, ids[k], x, y, z);
+      pointTiles[k] = tileOf(x, y, z);
+    }
+    const uint64_t maxTile(numTileX * numTileY * numTileZ - 1);
+    int tileBits = 0;
+    while(tileBits < 64 && (maxTile >> tileBits) != 0) tileBits++;
+    radixSortPairs(pointTiles, ids, tileBits);
+
+#ifdef USE_OpenMP
+    #pragma omp parallel for
+#endif
+    for (size_t k = 0; k < numPoints; k++) {
+      uint64_t x, y, z;
+      pointVoxel(points, ids[k], x, y, z);
+      pointKeys[k] = mortonEncode3(x, y, z);
+    }
+  }
+  auto isVoxelStart = [&](const size_t i) {
+    return i == 0 || pointKeys[i] != pointKeys[i - 1]
+        || (tiled && pointTiles[i] != pointTiles[i - 1]);
+  };
+
+  // voxel boundaries, counted and written per block
+  int numBlocks = 1;
+#ifdef USE_OpenMP
+  numBlocks = omp_get_max_threads();
+#endif
+  const size_t blockSize((numPoints + numBlocks - 1) / numBlocks);
+  std::vector<size_t> blockVoxels(numBlocks + 1, 0);
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(static, 1)
+#endif
+  for (int t = 0; t < numBlocks; t++) {
+    const size_t begin(std::min(numPoints, t * blockSize));
+    const size_t end(std::min(numPoints, begin + blockSize));
+    size_t count = 0;
+    for (size_t i = begin; i < end; i++)
+      if (isVoxelStart(i)) count++;
+    blockVoxels[t + 1] = count;
+  }
+  for (int t = 0; t < numBlocks; t++)
+    blockVoxels[t + 1] += blockVoxels[t];
+
+  const size_t numOccupied(blockVoxels[numBlocks]);
+  keys.resize(numOccupied);
+  tiles.resize(tiled ? numOccupied : 0);
+  starts.resize(numOccupied + 1);
+  starts[numOccupied] = numPoints;
+#ifdef USE_OpenMP
+  #pragma omp parallel for schedule(static, 1)
+#endif
+  for (int t = 0; t < numBlocks; t++) {
+    const size_t begin(std::min(numPoints, t * blockSize));
+    const size_t end(std::min(numPoints, begin + blockSize));
+    size_t v(blockVoxels[t]);
+    for (size_t i = begin; i < end; i++) {
+      if (isVoxelStart(i)) {
+        keys[v] = pointKeys[i];
+        if (tiled) tiles[v] = pointTiles[i];
+        starts[v] = i;
+        v++;
+      }
+    }
+  }
+}
+
+/// integer coordinates of voxel v in the whole grid
+void VoxelGrid::voxelCoordinates(const size_t v, uint64_t& x, uint64_t& y,
+                                 uint64_t& z) const {
+  mortonDecode3(keys[v], x, y, z);
+  if (tiles.empty()) return;
+  const uint64_t tile(tiles[v]);
+  x += (tile % numTileX) << kMortonAxisBits;
+  y += ((tile / numTileX) % numTileY) << kMortonAxisBits;
+  z += (tile / (numTileX * numTileY)) << kMortonAxisBits;
+}
+
+/// index of the voxel at integer coordinates (x, y, z) in the whole grid,
+/// numVoxels() if it holds no points
+size_t VoxelGrid::findVoxel(const uint64_t x, const uint64_t y,
+                            const uint64_t z) const {
+  if (x >= numVoxelX || y >= numVoxelY || z >= numVoxelZ) return numVoxels();
+  // voxels are ordered by (tile, key), mortonEncode3 keeps the coordinates
+  // inside the tile
+  const uint64_t key(mortonEncode3(x, y, z));
+  size_t first(0), count(keys.size());
+  if (!tiles.empty()) {
+    const uint64_t tile(tileOf(x, y, z));
+    const auto range(std::equal_range(tiles.begin(), tiles.end(), tile));
+    first = range.first - tiles.begin();
+    count = range.second - range.first;
+  }
+  const auto begin(keys.begin() + first);
+  const auto it(std::lower_bound(begin, begin + count, key));
+  if (it == begin + count || *it != key) return numVoxels();
+  return it - keys.begin();
+}
@@ -0,0 +1,107 @@
+#ifndef _VOXEL_GRID_H_
+#define _VOXEL_GRID_H_
+
+// STL
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+// 3DL headers
+#include <common.h>
+#include <pointCloud.h>
+#include <morton.h>
+
+/** \class VoxelGrid
+  * \brief Sorted voxel binning of a cloud.
+  *
+  * Computes a voxel key for every point in parallel and sorts the point ids
+  * by key with a parallel radix sort. Every occupied voxel is then a
+  * contiguous range of point ids, so per voxel work can run in parallel
+  * without any shared container or lock.
+  *
+  * Keys are 63 bit Morton codes of the integer voxel coordinates, which
+  * also orders the voxels along a space filling curve. Grids with more than
+  * 2^21 voxels along an axis are split into tiles of 2^21 voxels per axis,
+  * voxels are then identified by their tile and their Morton code inside
+  * the tile.
+  */
+class VoxelGrid {
+  private:
+    const float               leafSize;
+    float                     minX, minY, minZ; ///< origin of the grid
+    bool                      fixedOrigin; ///< origin set by setOrigin
+    uint64_t                  numVoxelX, numVoxelY, numVoxelZ;
+    uint64_t                  numTileX, numTileY, numTileZ;
+
+    std::vector<uint64_t>     keys; ///< Morton code of the occupied voxels
+    std::vector<uint64_t>     tiles; ///< tile of each voxel, empty if untiled
+    std::vector<size_t>       starts; ///< start of each voxel in ids
+    std::vector<uint32_t>     ids; ///< point ids sorted by voxel
+
+  public:
+    VoxelGrid(const float & _leafSize);
+
+    /** Fixes the grid origin instead of using the minimum of the points
+     *
+     *  Lets separately binned parts of a cloud share one global grid.
+     *  Points below the origin fall into the first voxel layer.
+     */
+    void setOrigin(const float x, const float y, const float z) {
+      minX = x; minY = y; minZ = z;
+      fixedOrigin = true;
+    }
+
+    /// Bins the points, replacing any previous binning
+    void build(const XYZView& points);
+
+    inline size_t numVoxels() const { return keys.size(); }
+    inline bool isTiled() const { return numTileX * numTileY * numTileZ > 1; }
+
+    /// ids of the points in voxel v
+    inline const uint32_t* voxelBegin(const size_t v) const {
+      return ids.data() + starts[v];
+    }
+    inline size_t voxelSize(const size_t v) const {
+      return starts[v + 1] - starts[v];
+    }
+
+    /// Morton code of voxel v inside its tile
+    inline uint64_t voxelKey(const size_t v) const { return keys[v]; }
+    /// linear tile index of voxel v, 0 if the grid isnt tiled
+    inline uint64_t voxelTile(const size_t v) const {
+      return tiles.empty() ? 0 : tiles[v];
+    }
+
+    /// integer coordinates of voxel v in the whole grid
+    void voxelCoordinates(const size_t v, uint64_t& x, uint64_t& y,
+                          uint64_t& z) const;
+
+    /// index of the voxel at integer coordinates (x, y, z) in the whole
+    /// grid, numVoxels() if it holds no points
+    size_t findVoxel(const uint64_t x, const uint64_t y,
+                     const uint64_t z) const;
+
+    /// all point ids, ordered by voxel
+    inline const std::vector<uint32_t>& pointIds() const { return ids; }
+
+  private:
+    /// integer coordinates of the voxel containing point i
+    inline void pointVoxel(const XYZView& points, const size_t i,
+                           uint64_t& x, uint64_t& y, uint64_t& z) const {
+      x = std::min<uint64_t>(numVoxelX - 1, static_cast<uint64_t>(
+          std::max(0.0f, (points.getX(i) - minX) / leafSize)));
+      y = std::min<uint64_t>(numVoxelY - 1, static_cast<uint64_t>(
+          std::max(0.0f, (points.getY(i) - minY) / leafSize)));
+      z = std::min<uint64_t>(numVoxelZ - 1, static_cast<uint64_t>(
+          std::max(0.0f, (points.getZ(i) - minZ) / leafSize)));
+    }
+
+    /// linear index of the tile holding voxel (x, y, z)
+    inline uint64_t tileOf(const uint64_t x, const uint64_t y,
+                           const uint64_t z) const {
+      return (x >> kMortonAxisBits) + numTileX * ((y >> kMortonAxisBits)
+          + numTileY * (z >> kMortonAxisBits));
+    }
+}; // class VoxelGrid
+
+#endif // _VOXEL_GRID_H_
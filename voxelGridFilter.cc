@@ -1,4 +1,8 @@
 #include <voxelGridFilter.h>
+
+#include <algorithm>
+#include <random>
+#include <utility>
 #ifdef USE_OpenMP
 #include <omp.h>
 #endif
@@ -8,76 +12,71 @@ void VoxelGridFilter::filter(const std::vector<Point> & inputPointCloud,
   const std::size_t numPoints(inputPointCloud.size());
   if(numPoints == 0) throwRuntimeError("Input point cloud cant be empty");
 
-  // finding min max
-  Point minP, maxP;
-  minP.x = minP.y = minP.z = std::numeric_limits<float>::max();
-  maxP.x = maxP.y = maxP.z = std::numeric_limits<float>::min();
-
-  for (const auto & p : inputPointCloud) {
-    if(p.x < minP.x) minP.x = p.x;
-    if(p.y < minP.y) minP.y = p.y;
-    if(p.z < minP.z) minP.z = p.z;
-    if(p.x > maxP.x) maxP.x = p.x;
-    if(p.y > maxP.y) maxP.y = p.y;
-    if(p.z > maxP.z) maxP.z = p.z;
-  }
-
-  const size_t numVoxelY(static_cast<size_t>(ceil((maxP.y - minP.y)/leafSize)));
-  const size_t numVoxelZ(static_cast<size_t>(ceil((maxP.z - minP.z)/leafSize)));
-
-  std::map<size_t, std::vector<size_t> > voxels;
-  std::vector<size_t> voxelIds;
-#ifdef USE_OpenMP
-  #pragma omp parallel for
-#endif
-  for (size_t i = 0; i < numPoints; i++) {
-    const Point & p = inputPointCloud[i];
-    const size_t x(static_cast<size_t>(floor((p.x - minP.x)/leafSize)));
-    const size_t y(static_cast<size_t>(floor((p.y - minP.y)/leafSize)));
-    const size_t z(static_cast<size_t>(floor((p.z - minP.z)/leafSize)));
-    const size_t id((z * numVoxelZ) + (y * numVoxelY) + x);
-#ifdef USE_OpenMP
-    #pragma omp critical(VoxelGridUpdate)
-#endif
-    {
-      if(voxels.find(id) == voxels.end()) {
-        voxels[id] = std::vector<size_t> ();
-        voxelIds.push_back(id);
-      }
-      voxels[id].push_back(i);
-    }
-  }
+  const XYZView view(inputPointCloud);
+  VoxelGrid voxels(leafSize);
+  if(hasGridOrigin)
+    voxels.setOrigin(gridOrigin[0], gridOrigin[1], gridOrigin[2]);
+  voxels.build(view);
 
-  const size_t numNewPoints(voxelIds.size());
+  const size_t numNewPoints(voxels.numVoxels());
   resultPointCloud.clear();
-  resultPointCloud.reserve(numNewPoints);
+  resultPointCloud.resize(numNewPoints);
 
   LOG << "Number of voxels = " << numNewPoints;
 #ifdef USE_OpenMP
-  #pragma omp parallel for
+  #pragma omp parallel for schedule(dynamic, 256)
 #endif
   for (size_t i = 0; i < numNewPoints; i++) {
-    const size_t vId(voxelIds[i]);
-    const size_t numVoxelPoints(voxels[vId].size());
+    const uint32_t* ids(voxels.voxelBegin(i));
+    const size_t numIds(voxels.voxelSize(i));
+    if(reduction != VoxelReduction::kMean)
+      resultPointCloud[i] = inputPointCloud[findMediod(view, ids, numIds)];
+    else
+      findMean(inputPointCloud, ids, numIds, resultPointCloud[i]);
+  }
+}
+
+void VoxelGridFilter::filter(const PointCloud & inputPointCloud,
+    PointCloud& resultPointCloud) {
+  const std::size_t numPoints(inputPointCloud.size());
+  if(numPoints == 0) throwRuntimeError("Input point cloud cant be empty");
+
+  const XYZView view(inputPointCloud);
+  VoxelGrid voxels(leafSize);
+  if(hasGridOrigin)
+    voxels.setOrigin(gridOrigin[0], gridOrigin[1], gridOrigin[2]);
+  voxels.build(view);
 
-    if (numVoxelPoints == 0) continue;
-    Point np;
-    if(useMediod) findMediod(inputPointCloud, voxels[vId], np);
-    else findMean(inputPointCloud, voxels[vId], np);
+  const size_t numNewPoints(voxels.numVoxels());
+  resultPointCloud = PointCloud(inputPointCloud.hasNormals(),
+                                inputPointCloud.hasColors(),
+                                inputPointCloud.hasFlags());
+  resultPointCloud.resize(numNewPoints);
 
+  LOG << "Number of voxels = " << numNewPoints;
 #ifdef USE_OpenMP
-    #pragma omp critical (PointsUpdate)
+  #pragma omp parallel for schedule(dynamic, 256)
 #endif
-    {
-      resultPointCloud.push_back(np);
-      voxels[vId].clear();
+  for (size_t i = 0; i < numNewPoints; i++) {
+    const uint32_t* ids(voxels.voxelBegin(i));
+    const size_t numIds(voxels.voxelSize(i));
+    if(reduction != VoxelReduction::kMean) {
+      const Point p(inputPointCloud.getPoint(findMediod(view, ids, numIds)));
+      resultPointCloud.setPoints(i, &p, 1);
+    } else {
+      findMean(inputPointCloud, ids, numIds, resultPointCloud, i);
     }
   }
 }
+
 void VoxelGridFilter::findMean(const std::vector<Point>& points,
-    const std::vector<size_t>& ids, Point & np) {
-  const size_t numVoxelPoints(ids.size());
-  for (const auto & j : ids) {
+    const uint32_t* ids, const size_t numIds, Point & np) {
+  const size_t numVoxelPoints(numIds);
+  // colors are summed wider than uint8_t to avoid wrapping
+  unsigned int r = 0, g = 0, b = 0, a = 0;
+  np = Point();
+  for (size_t k = 0; k < numIds; k++) {
+    const size_t j(ids[k]);
     const Point & p = points[j];
     np.x += p.x;
     np.y += p.y;
@@ -85,10 +84,10 @@ void VoxelGridFilter::findMean(const std::vector<Point>& points,
     np.nx += p.nx;
     np.ny += p.ny;
     np.nz += p.nz;
-    np.r += p.r;
-    np.g += p.g;
-    np.b += p.b;
-    np.a += p.a;
+    r += p.r;
+    g += p.g;
+    b += p.b;
+    a += p.a;
   }
   np.x /= numVoxelPoints;
   np.y /= numVoxelPoints;
@@ -96,33 +95,179 @@ void VoxelGridFilter::findMean(const std::vector<Point>& points,
   np.nx /= numVoxelPoints;
   np.ny /= numVoxelPoints;
   np.nz /= numVoxelPoints;
-  np.r /= numVoxelPoints;
-  np.g /= numVoxelPoints;
-  np.b /= numVoxelPoints;
-  np.a /= numVoxelPoints;
+  np.r = r / numVoxelPoints;
+  np.g = g / numVoxelPoints;
+  np.b = b / numVoxelPoints;
+  np.a = a / numVoxelPoints;
+}
+
+void VoxelGridFilter::findMean(const PointCloud& points,
+    const uint32_t* ids, const size_t numIds, PointCloud& result,
+    const size_t resultId) {
+  const size_t numVoxelPoints(numIds);
+  float x = 0, y = 0, z = 0;
+  for (size_t k = 0; k < numIds; k++) {
+    const size_t j(ids[k]);
+    x += points.x[j];
+    y += points.y[j];
+    z += points.z[j];
+  }
+  result.x[resultId] = x / numVoxelPoints;
+  result.y[resultId] = y / numVoxelPoints;
+  result.z[resultId] = z / numVoxelPoints;
+
+  if(points.hasNormals()) {
+    float nx = 0, ny = 0, nz = 0;
+    for (size_t k = 0; k < numIds; k++) {
+    const size_t j(ids[k]);
+      nx += points.nx[j];
+      ny += points.ny[j];
+      nz += points.nz[j];
+    }
+    result.nx[resultId] = nx / numVoxelPoints;
+    result.ny[resultId] = ny / numVoxelPoints;
+    result.nz[resultId] = nz / numVoxelPoints;
+  }
+
+  if(points.hasColors()) {
+    unsigned int r = 0, g = 0, b = 0, a = 0;
+    for (size_t k = 0; k < numIds; k++) {
+    const size_t j(ids[k]);
+      r += points.r[j];
+      g += points.g[j];
+      b += points.b[j];
+      a += points.a[j];
+    }
+    result.r[resultId] = r / numVoxelPoints;
+    result.g[resultId] = g / numVoxelPoints;
+    result.b[resultId] = b / numVoxelPoints;
+    result.a[resultId] = a / numVoxelPoints;
+  }
+
+  if(points.hasFlags()) result.flags[resultId] = 0;
 }
 
-void VoxelGridFilter::findMediod(const std::vector<Point>& points,
-    const std::vector<size_t>& ids, Point & np) {
-  float minDist = std::numeric_limits<float>::max();
-  size_t minId = 0;
-
-  for (const size_t & i : ids) {
-    const Point & a = points[i];
-    float dist = 0;
-
-    for (const size_t j : ids) {
-      if (i == j) continue;
-      const Point & b = points[j];
-      float curDist =
-        sqrt(pow((a.x- b.x),2) + pow((a.y - b.y),2) + pow((a.z-b.z),2));
-      dist += curDist;
+size_t VoxelGridFilter::findMediod(const XYZView& points,
+    const uint32_t* ids, const size_t numIds) {
+  if (numIds <= 2) return ids[0];
+
+  // gather the coordinates so the distance loops run over contiguous arrays
+  const size_t kStackPoints = 128;
+  float stackCoords[3 * kStackPoints];
+  std::vector<float> heapCoords;
+  float* coords = stackCoords;
+  if (numIds > kStackPoints) {
+    heapCoords.resize(3 * numIds);
+    coords = heapCoords.data();
+  }
+  float* xs = coords;
+  float* ys = coords + numIds;
+  float* zs = coords + 2 * numIds;
+  float cx = 0, cy = 0, cz = 0;
+  for (size_t k = 0; k < numIds; k++) {
+    xs[k] = points.getX(ids[k]);
+    ys[k] = points.getY(ids[k]);
+    zs[k] = points.getZ(ids[k]);
+    cx += xs[k];
+    cy += ys[k];
+    cz += zs[k];
+  }
+  cx /= numIds;
+  cy /= numIds;
+  cz /= numIds;
+
+  // the point nearest to the centroid, also a good first mediod candidate
+  size_t nearest = 0;
+  float nearestDist = std::numeric_limits<float>::max();
+  for (size_t k = 0; k < numIds; k++) {
+    const float dx(xs[k] - cx), dy(ys[k] - cy), dz(zs[k] - cz);
+    const float d(dx * dx + dy * dy + dz * dz);
+    if (d < nearestDist) {
+      nearest = k;
+      nearestDist = d;
+    }
+  }
+  if (reduction == VoxelReduction::kCentroidNearest) return ids[nearest];
+
+  // summed distance from candidate c to the points [begin, end), stops
+  // once the sum reaches bound
+  auto sumDistances = [&](const size_t c, const size_t begin,
+                          const size_t end, const float bound) {
+    const size_t kBlock = 32;
+    float sum = 0;
+    for (size_t j = begin; j < end && sum < bound; j += kBlock) {
+      const size_t blockEnd(std::min(end, j + kBlock));
+      float blockSum = 0;
+      for (size_t l = j; l < blockEnd; l++) {
+        const float dx(xs[c] - xs[l]), dy(ys[c] - ys[l]), dz(zs[c] - zs[l]);
+        blockSum += std::sqrt(dx * dx + dy * dy + dz * dz);
+      }
+      sum += blockSum;
+    }
+    return sum;
+  };
+
+  if (reduction == VoxelReduction::kSampledMediod
+      && numIds >= 2 * mediodSamples) {
+    // estimate every candidate's mean distance from random reference points
+    std::minstd_rand generator(ids[0]);
+    std::uniform_int_distribution<size_t> pick(0, numIds - 1);
+    std::vector<float> samples(3 * mediodSamples);
+    float* sx = samples.data();
+    float* sy = sx + mediodSamples;
+    float* sz = sy + mediodSamples;
+    for (size_t s = 0; s < mediodSamples; s++) {
+      const size_t j(pick(generator));
+      sx[s] = xs[j];
+      sy[s] = ys[j];
+      sz[s] = zs[j];
+    }
+
+    std::vector<std::pair<float, size_t> > estimates(numIds);
+    for (size_t k = 0; k < numIds; k++) {
+      float sum = 0;
+      for (size_t s = 0; s < mediodSamples; s++) {
+        const float dx(xs[k] - sx[s]), dy(ys[k] - sy[s]), dz(zs[k] - sz[s]);
+        sum += std::sqrt(dx * dx + dy * dy + dz * dz);
+      }
+      estimates[k] = std::make_pair(sum / mediodSamples, k);
+    }
+
+    // Hoeffding bound on the estimates, distances are at most the diagonal
+    const float bound(leafSize * std::sqrt(3.0f * std::log(200.0f * numIds)
+                                           / (2.0f * mediodSamples)));
+
+    // candidates that can still be the mediod are checked exactly
+    const size_t kMaxRefine = 8;
+    const size_t numRefine(std::min(kMaxRefine, numIds));
+    std::partial_sort(estimates.begin(), estimates.begin() + numRefine,
+                      estimates.end());
+    size_t minId = estimates[0].second;
+    float minDist = sumDistances(minId, 0, numIds,
+                                 std::numeric_limits<float>::max());
+    for (size_t r = 1; r < numRefine; r++) {
+      if (estimates[r].first > estimates[0].first + 2 * bound) break;
+      const size_t k(estimates[r].second);
+      const float dist(sumDistances(k, 0, numIds, minDist));
+      if (dist < minDist) {
+        minId = k;
+        minDist = dist;
+      }
     }
+    return ids[minId];
+  }
 
+  // exact mediod, pruned by the best sum found so far
+  float minDist = sumDistances(nearest, 0, numIds,
+                               std::numeric_limits<float>::max());
+  size_t minId = nearest;
+  for (size_t k = 0; k < numIds; k++) {
+    if (k == nearest) continue;
+    const float dist(sumDistances(k, 0, numIds, minDist));
     if (dist < minDist) {
-      minId = i;
+      minId = k;
       minDist = dist;
     }
   }
-  np = points[minId];
+  return ids[minId];
 }
@@ -10,27 +10,81 @@
 // 3DL headers
 #include <common.h>
 #include <plyIO.h>
+#include <pointCloud.h>
+#include <voxelGrid.h>
+
+/*! brief How the points of a voxel are reduced to one point
+ *
+ *  The mediod is the point with the least summed distance to all other
+ *  points of the voxel.
+ */
+enum class VoxelReduction : uint8_t {
+  kMean,            ///< mean of all attributes
+  kMediod,          ///< exact mediod, pruned but O(k^2) in the worst case
+  kCentroidNearest, ///< point closest to the centroid, O(k)
+  kSampledMediod,   ///< mediod estimated from samples, O(k * samples)
+};
 
 class VoxelGridFilter {
   protected:
     const float               leafSize;
-    const bool                useMediod;
+    const VoxelReduction      reduction;
+    /// number of reference points used by kSampledMediod
+    const size_t              mediodSamples;
+    /// grid origin set by setGridOrigin, else the minimum of the input
+    bool                      hasGridOrigin;
+    float                     gridOrigin[3];
 
   public:
     VoxelGridFilter(const float & _leafSize = 0.01f,
                     const bool & _useMediod = true)
-      : leafSize(_leafSize), useMediod(_useMediod) {
+      : leafSize(_leafSize),
+        reduction(_useMediod ? VoxelReduction::kMediod : VoxelReduction::kMean),
+        mediodSamples(64), hasGridOrigin(false) {
+      if(leafSize <= 0.0f) throwRuntimeError("Leaf size cannot be <= 0.0f");
+    }
+
+    /** Selects the reduction explicitly
+     *
+     *  With kSampledMediod the summed distances are estimated from
+     *  _mediodSamples random points of the voxel. With probability 0.99 the
+     *  selected point's mean distance to the voxel is within
+     *  2 * leafSize * sqrt(3 * ln(200 k) / (2 * _mediodSamples)) of the
+     *  exact mediod's, k being the number of points in the voxel. Voxels
+     *  with fewer than 2 * _mediodSamples points are solved exactly.
+     */
+    VoxelGridFilter(const float & _leafSize, const VoxelReduction & _reduction,
+                    const size_t & _mediodSamples = 64)
+      : leafSize(_leafSize), reduction(_reduction),
+        mediodSamples(_mediodSamples), hasGridOrigin(false) {
       if(leafSize <= 0.0f) throwRuntimeError("Leaf size cannot be <= 0.0f");
+      if(mediodSamples == 0) throwRuntimeError("Mediod samples cannot be 0");
+    }
+
+    /// Aligns the voxels to a fixed origin instead of the input minimum
+    void setGridOrigin(const float x, const float y, const float z) {
+      gridOrigin[0] = x; gridOrigin[1] = y; gridOrigin[2] = z;
+      hasGridOrigin = true;
     }
 
     void filter(const std::vector<Point>& inputPointCloud,
               std::vector<Point>& resultPointCloud);
 
+    /// Filters a structure of arrays cloud, binning only reads coordinates
+    void filter(const PointCloud& inputPointCloud,
+              PointCloud& resultPointCloud);
+
   protected:
-    void findMediod(const std::vector<Point>& points,
-                    const std::vector<size_t>& ids, Point & np);
-    void findMean(const std::vector<Point>& points,
-                    const std::vector<size_t>& ids, Point & np);
+    /// returns the id of the representative point for the reduction mode
+    size_t findMediod(const XYZView& points, const uint32_t* ids,
+                    const size_t numIds);
+
+    void findMean(const std::vector<Point>& points, const uint32_t* ids,
+                    const size_t numIds, Point & np);
+    /// writes the mean of the attributes of ids to result at resultId
+    void findMean(const PointCloud& points, const uint32_t* ids,
+                    const size_t numIds, PointCloud& result,
+                    const size_t resultId);
 
 }; // class VoxelGridFilter
 